@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <err.h>
+
+#include <utils.h>
+#include <churn.h>
+
+/* The thread wakes up this often to swap the ranks due so far. */
+#define CHURN_TICK	0.01
+
+void init_churn(struct churn *churn, long n, double swap_rate,
+	double period, uint32_t *seeds, int len, int nreaders)
+{
+	long i;
+
+	assert(n >= 1 && n <= UINT32_MAX);
+	assert(nreaders >= 1);
+	assert(swap_rate >= 0.0);
+	assert(period >= 0.0);
+
+	churn->map = malloc(sizeof(churn->map[0]) * n);
+	assert(churn->map);
+	for (i = 0; i < n; i++)
+		churn->map[i] = i;
+	churn->spare = NULL;
+	if (period > 0) {
+		churn->spare = malloc(sizeof(churn->spare[0]) * n);
+		assert(churn->spare);
+	}
+	churn->epoch = 0;
+	assert(!posix_memalign((void **)&churn->readers,
+		__alignof__(*churn->readers),
+		sizeof(*churn->readers) * nreaders));
+	for (i = 0; i < nreaders; i++)
+		churn->readers[i].epoch = 0;
+	churn->nreaders = nreaders;
+	churn->n = n;
+	churn->swap_rate = swap_rate;
+	churn->period = period;
+	init_unif(&churn->unif, seeds, len);
+	churn->running = 0;
+}
+
+static void swap_ranks(struct churn *churn, long swaps)
+{
+	uint32_t *map = churn->map;
+
+	while (swaps-- > 0) {
+		long a = sample_unif_0_n1(&churn->unif, churn->n);
+		long b = sample_unif_0_n1(&churn->unif, churn->n);
+		uint32_t tmp = map[a];
+		__atomic_store_n(&map[a], map[b], __ATOMIC_RELAXED);
+		__atomic_store_n(&map[b], tmp, __ATOMIC_RELAXED);
+	}
+}
+
+/* RETURN true if no reader reads @spare anymore; that is, every reader
+ * has reported after the reshuffle that replaced @spare.
+ */
+static int spare_is_free(struct churn *churn)
+{
+	int i;
+
+	for (i = 0; i < churn->nreaders; i++)
+		if (__atomic_load_n(&churn->readers[i].epoch,
+			__ATOMIC_ACQUIRE) < churn->epoch)
+			return 0;
+	return 1;
+}
+
+/* Shuffle a copy of the mapping, and publish it at once, so senders
+ * never see a partially shuffled mapping.
+ * RETURN false if the reshuffle must be postponed.
+ */
+static int reshuffle_ranks(struct churn *churn)
+{
+	uint32_t *map = churn->spare;
+	long i;
+
+	if (!spare_is_free(churn))
+		return 0;
+	memmove(map, churn->map, sizeof(map[0]) * churn->n);
+	for (i = churn->n - 1; i > 0; i--) {
+		long j = sample_unif_0_n(&churn->unif, i);
+		uint32_t tmp = map[i];
+		map[i] = map[j];
+		map[j] = tmp;
+	}
+
+	/* Readers that see the new epoch also see the new mapping. */
+	churn->spare = churn->map;
+	__atomic_store_n(&churn->map, map, __ATOMIC_RELEASE);
+	__atomic_store_n(&churn->epoch, churn->epoch + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+static void *run_churn(void *arg)
+{
+	struct churn *churn = arg;
+	double start = now();
+	double last = start;
+	double next_reshuffle = start + churn->period;
+	double owed = 0.0;	/* Swaps due, but not done yet. */
+
+	while (1) {
+		double t;
+
+		nsleep(CHURN_TICK);
+		t = now();
+
+		if (churn->swap_rate > 0) {
+			owed += churn->swap_rate * (t - last);
+			swap_ranks(churn, (long)owed);
+			owed -= (long)owed;
+		}
+		last = t;
+
+		if (churn->period > 0 && t >= next_reshuffle &&
+			reshuffle_ranks(churn))
+			next_reshuffle += churn->period;
+	}
+	return NULL;
+}
+
+void start_churn(struct churn *churn)
+{
+	if (pthread_create(&churn->thread, NULL, run_churn, churn))
+		errx(1, "Can't create thread of rank churn");
+	churn->running = 1;
+}
+
+void end_churn(struct churn *churn)
+{
+	if (churn->running) {
+		assert(!pthread_cancel(churn->thread));
+		assert(!pthread_join(churn->thread, NULL));
+		churn->running = 0;
+	}
+	end_unif(&churn->unif);
+	free(churn->readers);
+	free(churn->spare);
+	free(churn->map);
+	churn->readers = NULL;
+	churn->spare = NULL;
+	churn->map = NULL;
+}
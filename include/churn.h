@@ -0,0 +1,78 @@
+#ifndef _CHURN_H
+#define _CHURN_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <rdist.h>		/* struct unif_state	*/
+
+/* Time-varying popularity: a thread permutes the mapping from Zipf ranks
+ * to destinations, either gradually (@swap_rate random pairs of ranks
+ * swapped per second), or abruptly (a full reshuffle every @period
+ * seconds), or both.
+ *
+ * Senders only read the mapping with churn_rank(), so they never wait
+ * for the thread.
+ *
+ * A reshuffle replaces the mapping with @spare, and the replaced mapping
+ * becomes the next @spare. The thread only reuses it once every sender
+ * has reported with churn_quiescent() that it no longer reads it;
+ * until then, the reshuffle is postponed.
+ */
+struct churn_reader {
+	/* Last @epoch that the reader reported. */
+	uint64_t epoch __attribute__((aligned(64)));
+};
+
+struct churn {
+	uint32_t *map;		/* Rank - 1 to index - 1.		*/
+	uint32_t *spare;	/* Next @map of a full reshuffle.	*/
+	uint64_t epoch;		/* Number of reshuffles.		*/
+	struct churn_reader *readers;
+	int nreaders;
+	long n;
+	double swap_rate;	/* Zero disables swaps.			*/
+	double period;		/* Zero disables reshuffles.		*/
+	struct unif_state unif;
+	pthread_t thread;
+	int running;
+};
+
+/* The mapping starts as the identity over [1..n].
+ * @nreaders senders, numbered from zero, read it.
+ */
+void init_churn(struct churn *churn, long n, double swap_rate,
+	double period, uint32_t *seeds, int len, int nreaders);
+
+void start_churn(struct churn *churn);
+
+/* It also stops the thread if it was started. */
+void end_churn(struct churn *churn);
+
+/* Return the destination in [1..n] of rank @rank in [1..n]. */
+static inline long churn_rank(struct churn *churn, long rank)
+{
+	uint32_t *map = __atomic_load_n(&churn->map, __ATOMIC_ACQUIRE);
+	return __atomic_load_n(&map[rank - 1], __ATOMIC_RELAXED) + 1;
+}
+
+/* Report that @reader is done with the mappings that it has read so far;
+ * call it often, e.g., once per batch of packets.
+ */
+static inline void churn_quiescent(struct churn *churn, int reader)
+{
+	__atomic_store_n(&churn->readers[reader].epoch,
+		__atomic_load_n(&churn->epoch, __ATOMIC_ACQUIRE),
+		__ATOMIC_RELEASE);
+}
+
+/* Same as churn_quiescent(), but also for any later reshuffle, so
+ * a reader that blocks does not postpone them; call churn_quiescent()
+ * before reading the mapping again.
+ */
+static inline void churn_offline(struct churn *churn, int reader)
+{
+	__atomic_store_n(&churn->readers[reader].epoch, UINT64_MAX,
+		__ATOMIC_RELEASE);
+}
+
+#endif	/* _CHURN_H */
@@ -0,0 +1,68 @@
+#ifndef _PACE_H
+#define _PACE_H
+
+#include <stdint.h>
+#include <rdist.h>		/* struct unif_state	*/
+
+/* Token bucket that releases packets following a schedule of departures.
+ *
+ * The schedule is absolute (e.g. for a constant rate, the k-th packet is
+ * due at @start + k / @rate), so rounding errors do not accumulate, and
+ * packets not sent on time are sent as soon as possible, up to
+ * @depth packets.
+ */
+struct pace {
+	double rate;		/* Mean packets per second.		*/
+	double start;		/* Time at which the schedule starts.	*/
+	uint64_t due;		/* Departures due so far.		*/
+	uint64_t consumed;	/* Tokens consumed so far.		*/
+	uint64_t depth;		/* Maximum number of tokens.		*/
+
+	/* Fields below are only used by random inter-departure times;
+	 * @gaps is NULL for a constant rate.
+	 */
+	double next;		/* Next departure since @start.		*/
+	double *gaps;		/* Ring of gaps drawn ahead.		*/
+	int gap_index;		/* Next entry of @gaps to use.		*/
+	int gap_count;		/* Entries of @gaps drawn, not used.	*/
+	double (*draw_gap)(struct pace *pace);
+	struct unif_state unif;
+
+	/* On/off model only. */
+	double peak;		/* Rate while on.			*/
+	double on_mean;		/* Mean duration of on periods.		*/
+	double off_mean;	/* Mean duration of off periods.	*/
+	double on_left;		/* Time left in current on period.	*/
+};
+
+/* Constant rate. */
+void init_pace(struct pace *pace, double rate, uint64_t depth);
+
+/* Poisson arrivals, that is, exponential inter-departure times. */
+void init_pace_poisson(struct pace *pace, double rate, uint64_t depth,
+	uint32_t *seeds, int len);
+
+/* On/off source, that is, a Markov-modulated Poisson process with
+ * exponentially distributed on and off periods of means @on_mean and
+ * @off_mean seconds. Packets only depart while on, so the peak rate is
+ * @rate * (@on_mean + @off_mean) / @on_mean.
+ */
+void init_pace_onoff(struct pace *pace, double rate, uint64_t depth,
+	double on_mean, double off_mean, uint32_t *seeds, int len);
+
+void end_pace(struct pace *pace);
+
+/* Wait until at least one token is available.
+ * RETURN the number of tokens available, which is at least 1.
+ */
+uint64_t pace_wait(struct pace *pace);
+
+/* Consume @n tokens; @n must not be greater than the number of
+ * tokens returned by the last call to pace_wait().
+ */
+static inline void pace_consume(struct pace *pace, uint64_t n)
+{
+	pace->consumed += n;
+}
+
+#endif	/* _PACE_H */
@@ -2,6 +2,7 @@
 #define _RDIST_H
 
 #include <stdint.h>
+#include <math.h>
 
 #include <dSFMT.h>
 
@@ -37,17 +38,281 @@ static inline long sample_unif_0_n(struct unif_state *unif, long n)
 	return (long)(dsfmt_genrand_close_open(&unif->state) * (n + 1.0));
 }
 
+/* Return a random number of the exponential distribution of mean @mean. */
+static inline double sample_exp(struct unif_state *unif, double mean)
+{
+	/* 1 - U is in (0, 1], so the log is finite. */
+	return -mean * log(1.0 - dsfmt_genrand_close_open(&unif->state));
+}
+
+/* Popularity of ranks [1..n], that is, the unnormalized weight of
+ * each rank. All popularities are sampled through an alias table;
+ * see init_popularity_alias().
+ */
+struct popularity {
+	double (*weight)(struct popularity *pop, long rank);
+	long n;
+	double s;		/* Exponent of Zipf-Mandelbrot.		*/
+	double q;		/* Shift of Zipf-Mandelbrot.		*/
+	double alpha;		/* Shape of Pareto.			*/
+	double *counts;		/* Counts of the histogram.		*/
+	long counts_n;
+};
+
+/* All ranks are equally popular. */
+void init_popularity_uniform(struct popularity *pop, long n);
+
+/* Zipf-Mandelbrot: the weight of rank i is 1 / (i + @q)^@s.
+ * When @q is zero, it is the Zipf distribution.
+ */
+void init_popularity_zipf(struct popularity *pop, double s, double q,
+	long n);
+
+/* The popularities of prefixes are Pareto distributed with shape @alpha;
+ * the weight of rank i is the quantile of tail probability (i - 0.5) / n.
+ */
+void init_popularity_pareto(struct popularity *pop, double alpha, long n);
+
+/* Empirical histogram: line i of @filename holds the observed count
+ * of rank i. Ranks beyond the last line are never sampled.
+ */
+void init_popularity_histogram(struct popularity *pop, const char *filename,
+	long n);
+
+void end_popularity(struct popularity *pop);
+
+/* Zipf distribution sampled by inversion of its CDF.
+ * Reference: http://en.wikipedia.org/wiki/Zipf%27s_law
+ *
+ * A guide table indexed by the uniform number narrows the binary search
+ * over @cdf down to a few entries.
+ */
+struct zipf_state {
+	double s;
+	long n;
+	double *cdf;
+	long guide_size;
+	uint32_t *guide;
+};
+
+/* When s == 0, it's just the uniform distribution. */
+void init_zipf(struct zipf_state *state, double s, long n);
+void end_zipf(struct zipf_state *state);
+
+/* Return the sample in [1..n] of uniform number @z.
+ * IMPORTANT: z must be in [0, 1) OR [0, 1].
+ */
+long sample_zipf(struct zipf_state *state, double z);
+
+/* Alias method of Walker with the construction of Vose.
+ * Reference: http://www.keithschwarz.com/darts-dice-coins/
+ *
+ * It samples [1..n] in O(1) with a single uniform number, and takes
+ * 12 bytes per outcome.
+ */
+struct alias_table {
+	long n;
+	double *prob;
+	uint32_t *alias;
+};
+
+/* Allocate @table for @n outcomes.
+ * Fill @table->prob[i] with the weight of outcome (i + 1), and
+ * call build_alias_table() before sampling @table.
+ */
+void init_alias_table(struct alias_table *table, long n);
+void build_alias_table(struct alias_table *table);
+void end_alias_table(struct alias_table *table);
+
+/* Return a random number in [1..n] distributed as the weights of @table.
+ * @table is only read, so threads can share it as long as
+ * each thread has its own @unif.
+ */
+static inline long sample_alias(struct alias_table *table,
+	struct unif_state *unif)
+{
+	double u = dsfmt_genrand_close_open(&unif->state) * table->n;
+	long i = (long)u;
+	return (u - i < table->prob[i] ? i : (long)table->alias[i]) + 1;
+}
+
+/* Initialize and build @table for @pop. */
+void init_popularity_alias(struct alias_table *table, struct popularity *pop);
+
+/* Rejection-inversion sampler of the Zipf distribution.
+ * Reference: W. Hormann, G. Derflinger, "Rejection-inversion to generate
+ * variates from monotone discrete distributions", ACM TOMACS, 1996.
+ *
+ * It takes O(1) memory and O(1) expected time per sample, so its
+ * initialization does not depend on @n.
+ * It is only read while sampling, so threads can share it as long as
+ * each thread has its own @unif.
+ */
+struct zipf_rejinv {
+	double s;
+	long n;
+	double h_x1;	/* H(1.5) - 1.		*/
+	double h_n;	/* H(n + 0.5).		*/
+	double t;	/* Squeeze threshold.	*/
+};
+
+void init_zipf_rejinv(struct zipf_rejinv *zipf, double s, long n);
+
+/* Return a random number in [1..n]. */
+long sample_zipf_rejinv(struct zipf_rejinv *zipf, struct unif_state *unif);
+
+/* Destinations with temporal locality, following the LRU stack model.
+ * Reference: Mattson et al., "Evaluation techniques for storage
+ * hierarchies", IBM Systems Journal, 1970.
+ *
+ * With probability @p_repeat, a packet repeats the destination at
+ * a stack distance in [1..depth] of the stack of recent destinations;
+ * distances follow the Zipf distribution of parameter @s, so 1 (i.e.
+ * the last destination) is the most likely one. Otherwise, the packet
+ * goes to a fresh destination that the caller draws and pushes.
+ *
+ * Pushing a fresh destination is O(1), and a repeat at distance d is
+ * a memmove() of d entries, so it runs at line rate. A fresh destination
+ * may already be in the stack; it is not looked up.
+ */
+struct lru_stack {
+	long *stack;	/* Circular; @stack[@top] is the most recent. */
+	long depth;	/* A power of 2. */
+	long top;
+	long used;	/* Number of entries of @stack filled so far. */
+	double p_repeat;
+	struct alias_table dist;	/* Stack distances. */
+};
+
+void init_lru_stack(struct lru_stack *lru, long depth, double p_repeat,
+	double s);
+void end_lru_stack(struct lru_stack *lru);
+
+/* Return the repeated destination, which becomes the most recent one,
+ * or 0 when the packet should go to a fresh destination; in this case,
+ * call push_lru_stack() with the fresh destination.
+ */
+long sample_lru_stack(struct lru_stack *lru, struct unif_state *unif);
+
+static inline void push_lru_stack(struct lru_stack *lru, long dst)
+{
+	lru->top = (lru->top - 1) & (lru->depth - 1);
+	lru->stack[lru->top] = dst;
+	if (lru->used < lru->depth)
+		lru->used++;
+}
+
+/* Flows: each packet belongs to one of @n concurrent flows chosen
+ * uniformly at random. When the chosen flow has no packets left,
+ * the caller draws a fresh destination, and start_flow() starts a new flow
+ * in its slot with a heavy-tailed number of packets of mean @mean.
+ *
+ * Flow sizes follow either the Pareto distribution of shape @shape
+ * (@shape > 1; the smaller, the heavier the tail), or the lognormal
+ * distribution whose normal has standard deviation @shape.
+ */
+#define FLOW_SIZE_PARETO	0
+#define FLOW_SIZE_LOGNORMAL	1
+
+struct flow {
+	uint32_t dst;
+	uint32_t left;	/* Packets left; zero means the slot is free. */
+};
+
+struct flow_table {
+	struct flow *flows;	/* A slab of @n flows. */
+	long n;
+	long slot;		/* Slot of the last sampled flow. */
+	int size_dist;
+	double mean;
+	double shape;
+	double scale;		/* x_m of Pareto, or mu of lognormal. */
+};
+
+void init_flow_table(struct flow_table *table, long n, int size_dist,
+	double mean, double shape);
+void end_flow_table(struct flow_table *table);
+
+/* Return the destination of the next packet, or 0 when its flow has
+ * ended; in this case, call start_flow() with a fresh destination.
+ */
+static inline long sample_flow(struct flow_table *table,
+	struct unif_state *unif)
+{
+	struct flow *flow;
+
+	table->slot = sample_unif_0_n1(unif, table->n);
+	flow = &table->flows[table->slot];
+	if (!flow->left)
+		return 0;
+	flow->left--;
+	return flow->dst;
+}
+
+/* Start a flow to @dst in the slot that sample_flow() found free;
+ * the current packet is its first one.
+ */
+void start_flow(struct flow_table *table, long dst, struct unif_state *unif);
+
 struct zipf_cache {
 	double s;
 	long n;
 	long index;
 	long sample_size;
 	long *samples;
+	size_t map_len;	/* Zero unless @samples is mapped from a file. */
+	int parallel;
 };
 
+/* If @parallel is false, samples are drawn from a single stream, so
+ * they are the samples of older versions.
+ *
+ * Otherwise, samples are drawn in parallel on all CPUs of count_cpus(),
+ * and each chunk of samples has its own stream. They only depend on
+ * (@s, @n, @sample_size, @seeds), not on the number of CPUs, but
+ * they differ from the samples of older versions.
+ */
 void init_zipf_cache(struct zipf_cache *cache, long sample_size,
-	double s, long n, uint32_t *seeds, int len);
+	double s, long n, uint32_t *seeds, int len, int parallel);
+
+/* Same as init_zipf_cache(), but the samples are kept in a file in
+ * directory @dir keyed by (@s, @n, @sample_size, @seeds, @parallel).
+ *
+ * If the file exists, it is mapped read-only, so processes on the same
+ * host share its pages. Otherwise, the samples are generated and
+ * the file is written for later calls.
+ */
+void init_zipf_cache_file(struct zipf_cache *cache, const char *dir,
+	long sample_size, double s, long n, uint32_t *seeds, int len,
+	int parallel);
+
+/* Publish the samples of @cache, which was initialized with @seeds, as
+ * shared-memory object @name; see shmem.h.
+ */
+void publish_zipf_cache(struct zipf_cache *cache, const char *name,
+	uint32_t *seeds, int len);
+
+/* Same as init_zipf_cache(), but attach the samples that
+ * publish_zipf_cache() published as object @name.
+ */
+void init_zipf_cache_shmem(struct zipf_cache *cache, const char *name,
+	long sample_size, double s, long n, uint32_t *seeds, int len,
+	int parallel);
+
 void end_zipf_cache(struct zipf_cache *cache);
+
+/* Make @slice the @i-th of @n contiguous slices of the samples of @cache.
+ * @i must be in [0..(n - 1)].
+ *
+ * The slices of a cache partition its samples, so sampling all slices
+ * gives the same destinations as sampling the whole cache.
+ *
+ * IMPORTANT: @slice shares its samples with @cache, so do not call
+ * end_zipf_cache() on @slice, and do not use @slice after @cache ends.
+ */
+void slice_zipf_cache(struct zipf_cache *slice, struct zipf_cache *cache,
+	int i, int n);
+
 long sample_zipf_cache(struct zipf_cache *cache);
 void print_zipf_cache(struct zipf_cache *cache);
 
@@ -12,7 +12,8 @@ struct port {
 struct rtnl_batch;
 
 typedef void (*add_route_to_batch_t)(struct rtnl_batch *b,
-	const struct net_prefix *prefix, const struct port *port, int update);
+	struct prefix_table *table, uint64_t i, const struct port *port,
+	int update);
 
 struct rtnl_batch {
 	struct mnl_socket *nl;
@@ -27,10 +28,12 @@ void init_rtnl_batch(struct rtnl_batch *b, const char *stack);
 int flush_rtnl_batch(struct rtnl_batch *b);
 void end_rtnl_batch(struct rtnl_batch *b);
 
+/* Add a route to prefix @i of @table. */
 static inline void rtnl_add_route_to_batch(struct rtnl_batch *b,
-	const struct net_prefix *prefix, const struct port *port, int update)
+	struct prefix_table *table, uint64_t i, const struct port *port,
+	int update)
 {
-	b->add_route(b, prefix, port, update);
+	b->add_route(b, table, i, port, update);
 }
 
 #endif	/* _RTNL_H */
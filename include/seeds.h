@@ -22,6 +22,14 @@ struct seed {
 void load_seeds(int run, int nnodes, int node_id,
 	struct seed *s1, struct seed *s2, struct seed *node_seed);
 
+/* Derive seed @derived from (@s, @tag).
+ *
+ * It allows a single seed of the seeds file to feed many independent
+ * streams of random numbers (e.g. one per thread) while keeping them
+ * reproducible; the same (@s, @tag) always derives the same seed.
+ */
+void derive_seed(const struct seed *s, uint32_t tag, struct seed *derived);
+
 /* Print seeds; it's useful for debuging. */
 void print_seed(const char *name, struct seed *s);
 
@@ -0,0 +1,53 @@
+#ifndef _SHMEM_H
+#define _SHMEM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Named POSIX shared-memory objects that one process publishes, and
+ * other processes on the same host attach read-only.
+ *
+ * An object holds a header followed by an array; the array starts at
+ * SHMEM_DATA_OFFSET, so it is page aligned once mapped.
+ * The header carries a key that identifies the parameters that generated
+ * the array, so processes never attach data of other parameters.
+ */
+
+#define SHMEM_KEY_LEN		16
+#define SHMEM_DATA_OFFSET	4096
+
+/* Names of the objects that pl publishes for pw under base name NAME:
+ * the shuffled prefix table, whose masks and ports are apart for XIA,
+ * and the Zipf samples of node ID.
+ */
+#define SHMEM_PREFIX_NAME	"/%s-prefix"		/* NAME		*/
+#define SHMEM_PREFIX_META_NAME	"/%s-prefix-meta"	/* NAME		*/
+#define SHMEM_ZIPF_NAME		"/%s-zipf-%i"		/* NAME, ID	*/
+
+/* Publish a copy of @data, an array of @count elements of @elem_size
+ * bytes, as object @name with key @key of @key_len words.
+ * An older object of the same name is replaced; processes that have
+ * attached it keep their copy.
+ */
+void publish_shmem(const char *name, const uint64_t *key, int key_len,
+	const void *data, uint32_t elem_size, uint64_t count);
+
+/* Attach object @name read-only, and return its array.
+ * @pcount receives its number of elements, and @pmap_len the length
+ * to pass to detach_shmem().
+ *
+ * It fails if @name does not exist, or was published with another key
+ * or element size.
+ */
+const void *attach_shmem(const char *name, const uint64_t *key, int key_len,
+	uint32_t elem_size, uint64_t *pcount, size_t *pmap_len);
+
+void detach_shmem(const void *data, size_t map_len);
+
+/* Pack @seeds into @key, and RETURN the number of words of @key used. */
+int seeds_to_shmem_key(uint64_t *key, const uint32_t *seeds, int len);
+
+/* RETURN 0 on success, or -1 if @name does not exist. */
+int unlink_shmem(const char *name);
+
+#endif	/* _SHMEM_H */
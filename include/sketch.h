@@ -0,0 +1,124 @@
+#ifndef _SKETCH_H
+#define _SKETCH_H
+
+#include <stdint.h>
+
+/* Streaming sketches to analyze streams of destinations in [1..n]
+ * in constant memory.
+ */
+
+/* Hash of destination @x; the sketches below share it. */
+static inline uint64_t hash_dst(uint64_t x)
+{
+	/* Finalizer of MurmurHash3 for 64 bits. */
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+/* HyperLogLog estimates the number of distinct destinations.
+ * Reference: Flajolet et al., "HyperLogLog: the analysis of a near-optimal
+ * cardinality estimation algorithm", AofA 2007.
+ *
+ * The standard error is 1.04 / sqrt(2^HLL_BITS), that is, 0.8%.
+ */
+#define HLL_BITS	14
+
+struct hll {
+	uint8_t regs[1 << HLL_BITS];
+};
+
+void init_hll(struct hll *hll);
+
+static inline void hll_add(struct hll *hll, uint64_t hash)
+{
+	uint32_t i = hash >> (64 - HLL_BITS);
+	uint64_t rest = hash << HLL_BITS;
+	/* Position of the first 1-bit of @rest, counting from 1. */
+	uint8_t rho = rest ? __builtin_clzll(rest) + 1 : 64 - HLL_BITS + 1;
+	if (rho > hll->regs[i])
+		hll->regs[i] = rho;
+}
+
+double hll_count(struct hll *hll);
+
+/* Space-saving keeps the @m most frequent destinations, and counts that
+ * overestimate their frequencies by at most N / @m after N samples.
+ * Reference: Metwally et al., "Efficient computation of frequent and
+ * top-k elements in data streams", ICDT 2005.
+ *
+ * Counters are kept sorted by count in increasing order, so each
+ * sample costs O(1): counters of equal count form groups, and
+ * a counter is incremented by swapping it to the end of its group.
+ */
+struct ss_counter {
+	uint64_t dst;
+	uint64_t count;		/* Zero means that the counter is unused. */
+	uint64_t error;		/* Maximum overestimation of @count.	*/
+	uint32_t slot;		/* Slot in the hash table.		*/
+	uint32_t group;		/* Group of equal counts.		*/
+};
+
+struct space_saving {
+	long m;
+	struct ss_counter *counters;
+	uint32_t *table;	/* Hash table of counter indexes + 1.	*/
+	long table_mask;
+	uint32_t *group_end;	/* Index of the last counter of groups.	*/
+	uint32_t *free_groups;
+	long nfree;
+};
+
+void init_space_saving(struct space_saving *ss, long m);
+void end_space_saving(struct space_saving *ss);
+void space_saving_add(struct space_saving *ss, uint64_t dst, uint64_t hash);
+
+/* Return the counter of the @i-th most frequent destination,
+ * starting from zero; its count is zero if there is no such destination.
+ */
+static inline struct ss_counter *space_saving_top(struct space_saving *ss,
+	long i)
+{
+	return &ss->counters[ss->m - 1 - i];
+}
+
+/* LRU cache of @size entries simulated on a spatially sampled stream:
+ * only destinations whose hash is below a threshold are simulated in
+ * a cache of proportionally smaller size.
+ * Reference: Waldspurger et al., "Efficient MRC construction with
+ * SHARDS", FAST 2015.
+ */
+struct lru_sim {
+	long size;		/* Size of the simulated cache.		*/
+	long sim_size;		/* Size of the sampled cache.		*/
+	uint64_t threshold;	/* Sample hashes below this.		*/
+	uint64_t refs;		/* Sampled references.			*/
+	uint64_t hits;		/* Sampled hits.			*/
+
+	/* Cache entries; @next and @prev form the LRU list, whose
+	 * head is the most recent entry, and @chain the hash chains.
+	 */
+	uint64_t *dst;
+	uint32_t *next;
+	uint32_t *prev;
+	uint32_t *chain;
+	uint32_t *buckets;
+	long bucket_mask;
+	long used;
+	uint32_t head;
+};
+
+/* @sim_size bounds the work and memory of the simulation. */
+void init_lru_sim(struct lru_sim *sim, long size, long sim_size);
+void end_lru_sim(struct lru_sim *sim);
+void lru_sim_add(struct lru_sim *sim, uint64_t dst, uint64_t hash);
+
+static inline double lru_sim_hit_rate(struct lru_sim *sim)
+{
+	return sim->refs ? (double)sim->hits / sim->refs : 0.0;
+}
+
+#endif	/* _SKETCH_H */
@@ -3,7 +3,7 @@
 
 #include <stdint.h>
 #include <strarray.h>		/* union net_addr	*/
-#include <netpacket/packet.h>	/* struct sockaddr_ll	*/
+#include <linux/if_packet.h>	/* struct sockaddr_ll	*/
 
 union sndpkt_cookie {
 	struct {
@@ -14,23 +14,92 @@ union sndpkt_cookie {
 	} xia;
 };
 
+/* Maximum number of packets of a call to sndpkt_send_batch(). */
+#define SNDPKT_MAX_BATCH	64
+
+/* Copies of the packet template used by sndpkt_send_batch() of
+ * backend 'socket'; they are sent with a single sendmmsg().
+ */
+struct sndpkt_batch {
+	char *pkts;
+	struct iovec *iov;
+	struct mmsghdr *msgs;
+};
+
+/* PACKET_MMAP TX ring; see Documentation/networking/packet_mmap.txt. */
+struct sndpkt_ring {
+	char *map;
+	size_t map_len;
+	unsigned int block_size;
+	unsigned int frame_size;
+	unsigned int frames_per_block;
+	unsigned int frame_nr;
+	unsigned int head;	/* Next frame to fill.			*/
+	unsigned int pending;	/* Frames filled, but not kicked yet.	*/
+};
+
+/* A ring shared with the kernel by an AF_XDP socket. */
+struct sndpkt_xsk_ring {
+	uint32_t *producer;
+	uint32_t *consumer;
+	uint32_t *flags;
+	void *descs;
+	void *map;
+	size_t map_len;
+};
+
+/* AF_XDP socket; see Documentation/networking/af_xdp.rst.
+ * The TX ring, the completion ring, and the UMEM all have @frame_nr
+ * entries, so frame i of the UMEM always goes in entry i of the TX ring.
+ */
+struct sndpkt_xdp {
+	char *umem;
+	size_t umem_len;
+	unsigned int frame_size;
+	unsigned int frame_nr;	/* Power of 2. */
+	uint32_t posted;	/* Producer index of the TX ring.	*/
+	uint32_t completed;	/* Consumer index of the completion ring. */
+	struct sndpkt_xsk_ring tx;
+	struct sndpkt_xsk_ring cq;
+};
+
 struct sndpkt_engine {
 	int sk; /* Socket. */
 	struct sockaddr_ll dev;
 	char *pkt_template;
 	int template_len;
 	union sndpkt_cookie cookie;
+	struct sndpkt_batch batch;	/* Only used by backend 'socket'. */
+	struct sndpkt_ring ring;	/* Only used by backend 'ring'. */
+	struct sndpkt_xdp xdp;		/* Only used by backend 'xdp'. */
+
+	/* Write destination @addr into packet @pkt, which is
+	 * a copy of @pkt_template.
+	 */
+	void (*set_dst)(struct sndpkt_engine *engine, char *pkt,
+		union net_addr *addr);
 	int (*send_packet)(struct sndpkt_engine *engine, union net_addr *addr);
+	int (*send_batch)(struct sndpkt_engine *engine, union net_addr **addrs,
+		int n);
+	void (*flush)(struct sndpkt_engine *engine);
 };
 
-void init_sndpkt_engine(struct sndpkt_engine *engine, const char *stack,
-	const char *ifname, int packet_len,
+/* @backend is either 'socket' (one sendto() per packet),
+ * 'ring' (PACKET_MMAP TX_RING, the kernel is kicked once per batch), or
+ * 'xdp' (AF_XDP socket bound to queue @queue of @ifname).
+ */
+void init_sndpkt_engine(struct sndpkt_engine *engine, const char *backend,
+	const char *stack, const char *ifname, int queue, int packet_len,
 	const unsigned char *dst_mac, int mac_len,
 	const char *dst_addr_type);
 
-/* IMPORTANT: This function does NOT support multiple threads!
+/* IMPORTANT: This function does NOT support multiple threads sharing
+ * an engine! Give each thread its own engine instead.
  * RETURN 1 if packet send, 0 otherwise.
  * A likely reason for that is `No buffer space available'.
+ *
+ * Backend 'ring' only queues the packet; call sndpkt_flush() to
+ * make sure that the packets already queued leave.
  */
 static inline int sndpkt_send(struct sndpkt_engine *engine,
 	union net_addr *addr)
@@ -38,6 +107,30 @@ static inline int sndpkt_send(struct sndpkt_engine *engine,
 	return engine->send_packet(engine, addr);
 }
 
+/* Send a packet to each destination in @addrs.
+ * @n must be in [1..SNDPKT_MAX_BATCH].
+ *
+ * IMPORTANT: As sndpkt_send(), this function does NOT support
+ * multiple threads sharing an engine!
+ * RETURN the number of packets sent, which are always the first ones
+ * of @addrs. As with sndpkt_send(), a likely reason for not sending
+ * all packets is `No buffer space available'.
+ *
+ * Differently from sndpkt_send(), there is no need to call
+ * sndpkt_flush() afterwards.
+ */
+static inline int sndpkt_send_batch(struct sndpkt_engine *engine,
+	union net_addr **addrs, int n)
+{
+	return engine->send_batch(engine, addrs, n);
+}
+
+/* Hand all queued packets to the kernel. */
+static inline void sndpkt_flush(struct sndpkt_engine *engine)
+{
+	engine->flush(engine);
+}
+
 void end_sndpkt_engine(struct sndpkt_engine *engine);
 
 #endif	/* _SNDPKT_H */
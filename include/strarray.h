@@ -2,6 +2,7 @@
 #define _STRARRAY_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <rdist.h>		/* struct unif_state	*/
 #include <net/xia.h>
 
@@ -22,12 +23,145 @@ struct net_prefix {
 	uint16_t	port;
 };
 
+/* Load the prefixes of text file @filename in the order of the file. */
+struct net_prefix *load_file_as_addrs(const char *filename,
+	uint64_t *parray_size, int force_addr);
+
 struct net_prefix *load_file_as_shuffled_addrs(const char *filename,
 	uint64_t *parray_size, uint32_t *seeds, int seeds_len, int force_addr);
 
-void assign_port(struct net_prefix *prefix, uint64_t array_size, int ports,
+/* Prefixes in the compact layout of a stack, which is what senders and
+ * route updaters keep in memory, and what binary prefix files and
+ * shared memory hold; struct net_prefix is only the layout that
+ * prefixes are parsed and generated in.
+ *
+ * IP keeps packed records of 8 bytes instead of 24.
+ * XIA keeps IDs apart from masks and ports, so a sender only touches
+ * the IDs, and a route updater mostly the masks and ports.
+ */
+#define PREFIX_TABLE_IP		0
+#define PREFIX_TABLE_XIA	1
+
+struct ip_prefix {
+	uint32_t	ip;
+	uint16_t	port;
+	uint8_t		mask;
+};
+
+struct prefix_meta {
+	uint16_t	port;
+	uint8_t		mask;
+};
+
+struct prefix_table {
+	int			stack;
+	uint64_t		n;
+	struct ip_prefix	*ip;	/* PREFIX_TABLE_IP.	*/
+	union net_addr		*xid;	/* PREFIX_TABLE_XIA.	*/
+	struct prefix_meta	*meta;	/* PREFIX_TABLE_XIA.	*/
+
+	/* Nonzero if the arrays are mapped instead of allocated. */
+	size_t			map_len;	/* Of @ip or @xid.	*/
+	size_t			meta_map_len;	/* Of @meta if apart.	*/
+};
+
+/* Copy the first @array_size prefixes of @prefix into @table. */
+void init_prefix_table(struct prefix_table *table, int stack,
+	const struct net_prefix *prefix, uint64_t array_size);
+
+void end_prefix_table(struct prefix_table *table);
+
+/* Load into @table the prefixes of @filename, either a text or
+ * a binary prefix file, in the order of load_file_as_shuffled_addrs().
+ * If @limit is not zero, only load the first @limit prefixes.
+ *
+ * Text files are streamed, and only the compact records of @table are
+ * kept, so files larger than memory can be loaded. A @limit takes
+ * an extra pass over the file to count its lines.
+ * Binary files are mapped copy-on-write, so the pages that nobody
+ * writes stay shared with the page cache.
+ *
+ * RETURN the number of prefixes in @filename.
+ */
+uint64_t load_prefix_table(struct prefix_table *table, int stack,
+	const char *filename, uint64_t limit, uint32_t *seeds, int seeds_len,
+	int force_addr);
+
+/* Write @table to the binary prefix file @filename, which only
+ * serves stack @table->stack.
+ * If @seeds_len is positive, @table must have been shuffled with @seeds,
+ * and load_prefix_table() will not shuffle it again.
+ */
+void write_prefix_file(const char *filename, const struct prefix_table *table,
+	uint32_t *seeds, int seeds_len, int force_addr);
+
+/* Publish the arrays of @table, as returned by load_prefix_table(), as
+ * shared-memory object @name, and for XIA, the masks and ports as
+ * object @meta_name; see shmem.h.
+ * The objects are keyed by the size and modification time of @filename,
+ * @seeds, @force_addr, and the stack.
+ */
+void publish_prefix_table(const char *name, const char *meta_name,
+	const char *filename, const struct prefix_table *table,
+	uint32_t *seeds, int seeds_len, int force_addr);
+
+/* Same as load_prefix_table(), but point @table at the arrays that
+ * publish_prefix_table() published as objects @name and @meta_name.
+ *
+ * IMPORTANT: the arrays are mapped read-only, so do not write @table,
+ * e.g. with set_prefix_table_port().
+ */
+uint64_t attach_prefix_table(struct prefix_table *table, int stack,
+	const char *name, const char *meta_name, const char *filename,
+	uint64_t limit, uint32_t *seeds, int seeds_len, int force_addr);
+
+/* RETURN the address of prefix @i.
+ * Only the field of the stack of @table is valid; for IP, it is @ip.
+ */
+static inline union net_addr *prefix_table_addr(struct prefix_table *table,
+	uint64_t i)
+{
+	if (table->stack == PREFIX_TABLE_IP)
+		return (union net_addr *)&table->ip[i].ip;
+	return &table->xid[i];
+}
+
+static inline int prefix_table_mask(struct prefix_table *table, uint64_t i)
+{
+	if (table->stack == PREFIX_TABLE_IP)
+		return table->ip[i].mask;
+	return table->meta[i].mask;
+}
+
+static inline int prefix_table_port(struct prefix_table *table, uint64_t i)
+{
+	if (table->stack == PREFIX_TABLE_IP)
+		return table->ip[i].port;
+	return table->meta[i].port;
+}
+
+static inline void set_prefix_table_port(struct prefix_table *table,
+	uint64_t i, int port)
+{
+	if (table->stack == PREFIX_TABLE_IP)
+		table->ip[i].port = port;
+	else
+		table->meta[i].port = port;
+}
+
+void assign_port(struct prefix_table *table, int ports,
 	struct unif_state *unif);
 
+/* Generate @n random prefixes from @seeds, in no particular order, so
+ * they need no shuffling; release them with free_net_prefix().
+ *
+ * For PREFIX_TABLE_IP, the IPv4 prefixes do not overlap, and
+ * their lengths follow those of the BGP table;
+ * for PREFIX_TABLE_XIA, they are random AD identifiers.
+ */
+struct net_prefix *generate_prefixes(uint64_t n, int stack,
+	uint32_t *seeds, int seeds_len, int force_addr);
+
 void free_net_prefix(struct net_prefix *prefix);
 
 #endif	/* _STRARRAY_H */
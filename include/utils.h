@@ -7,10 +7,22 @@
 
 long arg_to_long(const struct argp_state *state, const char *arg);
 
+double arg_to_double(const struct argp_state *state, const char *arg);
+
 double now(void);
 
 void nsleep(double seconds);
 
+/* RETURN the number of CPUs that the calling thread may run on,
+ * so it honors taskset(1).
+ */
+long count_cpus(void);
+
+/* Call @fn(@arg, c) for every c in [0..(@chunks - 1)] in parallel
+ * on all CPUs of count_cpus(); the caller runs some of the calls as well.
+ */
+void run_chunks(void (*fn)(void *arg, long chunk), void *arg, long chunks);
+
 #define printf_fsh(format...) ({		\
 	printf(format);				\
 	assert(!fflush(stdout));		\
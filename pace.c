@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+
+#include <utils.h>
+#include <pace.h>
+
+/* Waits shorter than this are spent spinning, since sleeping is not
+ * precise enough for them.
+ */
+#define PACE_SPIN	100e-6
+
+/* Inter-departure times are drawn ahead into a ring of PACE_GAPS
+ * entries, PACE_REFILL at a time: while pace_wait() has time to wait,
+ * or when the ring runs dry, so no call draws more than PACE_REFILL.
+ */
+#define PACE_GAPS	4096	/* Power of 2. */
+#define PACE_REFILL	64
+
+void init_pace(struct pace *pace, double rate, uint64_t depth)
+{
+	assert(rate > 0.0);
+	assert(depth >= 1);
+
+	pace->rate = rate;
+	pace->start = now();
+	pace->due = 0;
+	pace->consumed = 0;
+	pace->depth = depth;
+	pace->gaps = NULL;
+}
+
+static double draw_poisson_gap(struct pace *pace)
+{
+	return sample_exp(&pace->unif, 1.0 / pace->rate);
+}
+
+/* While on, departures are a Poisson process at @peak rate.
+ * Since exponential times are memoryless, a gap that does not fit in
+ * what is left of the on period is drawn again from the start of
+ * the next on period.
+ */
+static double draw_onoff_gap(struct pace *pace)
+{
+	double mean = 1.0 / pace->peak;
+	double gap = 0.0;
+	double g = sample_exp(&pace->unif, mean);
+
+	while (g > pace->on_left) {
+		gap += pace->on_left + sample_exp(&pace->unif, pace->off_mean);
+		pace->on_left = sample_exp(&pace->unif, pace->on_mean);
+		g = sample_exp(&pace->unif, mean);
+	}
+	pace->on_left -= g;
+	return gap + g;
+}
+
+/* Append @n gaps to the ring of @pace. */
+static void fill_gaps(struct pace *pace, int n)
+{
+	assert(pace->gap_count + n <= PACE_GAPS);
+	while (n-- > 0) {
+		pace->gaps[(pace->gap_index + pace->gap_count) &
+			(PACE_GAPS - 1)] = pace->draw_gap(pace);
+		pace->gap_count++;
+	}
+}
+
+static inline double next_gap(struct pace *pace)
+{
+	double gap;
+
+	if (!pace->gap_count)
+		fill_gaps(pace, PACE_REFILL);
+	gap = pace->gaps[pace->gap_index];
+	pace->gap_index = (pace->gap_index + 1) & (PACE_GAPS - 1);
+	pace->gap_count--;
+	return gap;
+}
+
+static void init_random_pace(struct pace *pace, double rate, uint64_t depth,
+	uint32_t *seeds, int len, double (*draw_gap)(struct pace *pace))
+{
+	init_pace(pace, rate, depth);
+	init_unif(&pace->unif, seeds, len);
+	pace->gaps = malloc(sizeof(pace->gaps[0]) * PACE_GAPS);
+	assert(pace->gaps);
+	pace->gap_index = 0;
+	pace->gap_count = 0;
+	pace->draw_gap = draw_gap;
+}
+
+/* Fill the whole ring before sending starts. */
+static void draw_first_gaps(struct pace *pace)
+{
+	fill_gaps(pace, PACE_GAPS);
+	pace->next = next_gap(pace);
+}
+
+void init_pace_poisson(struct pace *pace, double rate, uint64_t depth,
+	uint32_t *seeds, int len)
+{
+	init_random_pace(pace, rate, depth, seeds, len, draw_poisson_gap);
+	draw_first_gaps(pace);
+}
+
+void init_pace_onoff(struct pace *pace, double rate, uint64_t depth,
+	double on_mean, double off_mean, uint32_t *seeds, int len)
+{
+	assert(on_mean > 0.0);
+	assert(off_mean >= 0.0);
+
+	init_random_pace(pace, rate, depth, seeds, len, draw_onoff_gap);
+	pace->peak = rate * (on_mean + off_mean) / on_mean;
+	pace->on_mean = on_mean;
+	pace->off_mean = off_mean;
+	pace->on_left = sample_exp(&pace->unif, on_mean);
+	draw_first_gaps(pace);
+}
+
+void end_pace(struct pace *pace)
+{
+	if (!pace->gaps)
+		return;
+	free(pace->gaps);
+	pace->gaps = NULL;
+	end_unif(&pace->unif);
+}
+
+/* Return the number of departures due at @elapsed seconds. */
+static inline uint64_t pace_due(struct pace *pace, double elapsed)
+{
+	if (!pace->gaps)
+		return floor(elapsed * pace->rate);
+
+	while (pace->next <= elapsed) {
+		pace->due++;
+		pace->next += next_gap(pace);
+	}
+	return pace->due;
+}
+
+/* Return the time, since start, of the next departure not due. */
+static inline double pace_next(struct pace *pace)
+{
+	if (!pace->gaps)
+		return (pace->consumed + 1) / pace->rate;
+	return pace->next;
+}
+
+uint64_t pace_wait(struct pace *pace)
+{
+	while (1) {
+		double elapsed = now() - pace->start;
+		uint64_t due = pace_due(pace, elapsed);
+		double wait;
+
+		if (due > pace->consumed) {
+			uint64_t tokens = due - pace->consumed;
+			if (tokens <= pace->depth)
+				return tokens;
+
+			/* The bucket overflowed; drop the excess tokens. */
+			pace->consumed = due - pace->depth;
+			return pace->depth;
+		}
+
+		/* Spend the wait drawing gaps ahead, a step at a time,
+		 * so later departures need not draw them.
+		 */
+		if (pace->gaps &&
+			pace->gap_count <= PACE_GAPS - PACE_REFILL) {
+			fill_gaps(pace, PACE_REFILL);
+			continue;
+		}
+
+		/* Wait for the next departure. */
+		wait = pace_next(pace) - elapsed;
+		if (wait > PACE_SPIN)
+			nsleep(wait - PACE_SPIN);
+	}
+}
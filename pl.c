@@ -0,0 +1,233 @@
+/* Prefix Loader. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+#include <argp.h>
+#include <math.h>
+
+#include <utils.h>
+#include <seeds.h>
+#include <rdist.h>
+#include <strarray.h>
+#include <shmem.h>
+
+/* Argp's global variables. */
+const char *argp_program_version = "Prefix loader 1.0";
+
+static char doc[] = "PL -- load and shuffle the prefix file once, and "
+	"publish it in shared memory for all packet writers (see pw --shm) "
+	"on this host";
+
+static struct argp_option options[] = {
+	{"prefix",	'p', "FILE",	0, "Name of prefix file"},
+	{"stack",	's', "NET",	0,
+		"Publish the prefixes for the 'ip' or the 'xia' stack; "
+		"pw uses 'ip' for --daddr-type=ip, and 'xia' otherwise"},
+	{"prefix-limit", 'x', "N",	0,
+		"Consider only the first N entries of the prefix file *after* shuffling it"},
+	{"zipf",	'z', "EXP",	0, "Parameter s of Zipf distribution"},
+	{"cache",	'c', NULL,	0,
+		"Also publish the Zipf samples of sampler 'cache' of "
+		"every packet writer"},
+	{"pcache",	'P', NULL,	0,
+		"Publish the Zipf samples of sampler 'pcache' instead of "
+		"'cache'; it implies --cache"},
+	{"nnodes",	'n', "COUNT",	0,
+		"Number of nodes (= number of ports + 1)"},
+	{"run",		'r', "RUN",	0, "Run must be >= 1"},
+	{"shm",		'S', "NAME",	0,
+		"Base name of the shared memory objects"},
+	{"unlink",	'u', NULL,	0,
+		"Remove the shared memory objects instead of publishing them"},
+	{ 0 }
+};
+
+struct args {
+	const char *prefix_filename;
+	const char *stack;
+	uint64_t prefix_limit;
+	double s;
+	int cache;
+	int pcache;
+	int nnodes;
+	int run;
+	const char *shm_name;
+	int unlink;
+};
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+	struct args *args = state->input;
+
+	switch (key) {
+	case 'p':
+		args->prefix_filename = arg;
+		break;
+
+	case 's':
+		args->stack = arg;
+		if (strcmp(arg, "ip") && strcmp(arg, "xia"))
+			argp_error(state, "'%s' is not a valid stack", arg);
+		break;
+
+	case 'x':
+		args->prefix_limit = arg_to_long(state, arg);
+		if (args->prefix_limit < 1)
+			argp_error(state, "Prefix limit must be >= 1");
+		break;
+
+	case 'z':
+		args->s = arg_to_double(state, arg);
+		if (!(args->s >= 0 && args->s < INFINITY))
+			argp_error(state,"Zipf must be >= 0");
+		break;
+
+	case 'c':
+		args->cache = 1;
+		break;
+
+	case 'P':
+		args->cache = 1;
+		args->pcache = 1;
+		break;
+
+	case 'n':
+		args->nnodes = arg_to_long(state, arg);
+		if (args->nnodes < 2)
+			argp_error(state, "Number of nodes must be >= 2");
+		break;
+
+	case 'r':
+		args->run = arg_to_long(state, arg);
+		if (args->run < 1)
+			argp_error(state,"Run must be >= 1");
+		break;
+
+	case 'S':
+		args->shm_name = arg;
+		break;
+
+	case 'u':
+		args->unlink = 1;
+		break;
+
+	case ARGP_KEY_ARG:
+		argp_error(state, "There is no argument");
+		break;
+
+	case ARGP_KEY_END:
+		if (!args->shm_name)
+			argp_error(state, "Option --shm is required");
+		break;
+
+	default:
+		return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+
+static struct argp argp = {options, parse_opt, NULL, doc};
+
+static void make_name(char *name, size_t size, const char *format,
+	const char *base, int node_id)
+{
+	if (snprintf(name, size, format, base, node_id) >= size)
+		errx(1, "Name `%s' is too long", base);
+}
+
+static void unlink_objects(struct args *args)
+{
+	char name[256];
+	int node_id;
+
+	make_name(name, sizeof(name), SHMEM_PREFIX_NAME, args->shm_name, 0);
+	unlink_shmem(name);
+	make_name(name, sizeof(name), SHMEM_PREFIX_META_NAME, args->shm_name,
+		0);
+	unlink_shmem(name);
+	for (node_id = 1; node_id < args->nnodes; node_id++) {
+		make_name(name, sizeof(name), SHMEM_ZIPF_NAME, args->shm_name,
+			node_id);
+		unlink_shmem(name);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct args args = {
+		/* Defaults. */
+		.prefix_filename	= "prefix",
+		.stack			= "ip",
+		.prefix_limit		= 0,
+		.s			= 1.0,
+		.cache			= 0,
+		.pcache			= 0,
+		.nnodes			= 3,
+		.run			= 1,
+		.shm_name		= NULL,
+		.unlink			= 0,
+	};
+
+	struct seed s1, s2, node_seed;
+	struct prefix_table table;
+	uint64_t prefixes_count;
+	char name[256], meta_name[256];
+	int node_id;
+
+	/* Read parameters. */
+	argp_parse(&argp, argc, argv, 0, NULL, &args);
+
+	if (args.unlink) {
+		unlink_objects(&args);
+		return 0;
+	}
+
+	/* Load and shuffle destination addresses as pw does, and
+	 * publish the compact table that pw points at.
+	 */
+	load_seeds(args.run, args.nnodes, 1, &s1, &s2, &node_seed);
+	printf_fsh("Loading prefixes... ");
+	prefixes_count = load_prefix_table(&table,
+		strcmp(args.stack, "ip") ? PREFIX_TABLE_XIA : PREFIX_TABLE_IP,
+		args.prefix_filename, 0, s1.seeds, SEED_UINT32_N, 1);
+	if (!prefixes_count)
+		err(1, "Prefix file `%s' is empty", args.prefix_filename);
+	make_name(name, sizeof(name), SHMEM_PREFIX_NAME, args.shm_name, 0);
+	make_name(meta_name, sizeof(meta_name), SHMEM_PREFIX_META_NAME,
+		args.shm_name, 0);
+	publish_prefix_table(name, meta_name, args.prefix_filename, &table,
+		s1.seeds, SEED_UINT32_N, 1);
+	end_prefix_table(&table);
+	printf_fsh("DONE\n");
+
+	if (args.prefix_limit) {
+		if (args.prefix_limit > prefixes_count)
+			err(1, "Option --prefix-limit=%" PRIu64 " "
+				"is larger than the number of entries in "
+				"the prefix file `%s' (= %" PRIu64 ")",
+				args.prefix_limit, args.prefix_filename,
+				prefixes_count);
+		prefixes_count = args.prefix_limit;
+	}
+
+	/* Publish the Zipf samples of every packet writer. */
+	for (node_id = 1; args.cache && node_id < args.nnodes; node_id++) {
+		struct zipf_cache zcache;
+
+		printf_fsh("Publishing Zipf cache of node %i... ", node_id);
+		load_seeds(args.run, args.nnodes, node_id, &s1, &s2,
+			&node_seed);
+		init_zipf_cache(&zcache, prefixes_count * 30, args.s,
+			prefixes_count, node_seed.seeds, SEED_UINT32_N,
+			args.pcache);
+		make_name(name, sizeof(name), SHMEM_ZIPF_NAME, args.shm_name,
+			node_id);
+		publish_zipf_cache(&zcache, name, node_seed.seeds,
+			SEED_UINT32_N);
+		end_zipf_cache(&zcache);
+		printf_fsh("DONE\n");
+	}
+	return 0;
+}
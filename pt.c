@@ -0,0 +1,169 @@
+/* Prefix Table converter. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+#include <argp.h>
+
+#include <utils.h>
+#include <seeds.h>
+#include <strarray.h>
+
+/* Argp's global variables. */
+const char *argp_program_version = "Prefix table converter 1.0";
+
+static char doc[] = "PT -- convert a prefix file, or generate synthetic "
+	"prefixes, into a binary prefix file that pw, pl, and rk map instead "
+	"of parsing it (give it to their option --prefix)";
+
+static struct argp_option options[] = {
+	{"prefix",	'p', "FILE",	0, "Name of prefix file"},
+	{"output",	'o', "FILE",	0, "Name of binary prefix file"},
+	{"addr",	'a', NULL,	0,
+		"Store addresses instead of prefixes, as pw and pl need, "
+		"and rk needs for stacks other than 'ip'"},
+	{"shuffle",	's', NULL,	0,
+		"Store the prefixes shuffled for --run and --nnodes, so "
+		"loading them takes no time; the file only serves that run"},
+	{"synthetic",	'N', "N",	0,
+		"Generate N random prefixes for --run instead of converting "
+		"the prefix file, as pw and rk's option --synthetic do; "
+		"it implies --shuffle"},
+	{"xia",		'X', NULL,	0,
+		"Store the prefixes for the XIA stack, as pw needs for "
+		"--daddr-type other than 'ip', and rk for --stack other than "
+		"'ip'; with --synthetic, generate XIA AD identifiers instead "
+		"of IPv4 prefixes. It implies --addr"},
+	{"nnodes",	'n', "COUNT",	0,
+		"Number of nodes (= number of ports + 1)"},
+	{"run",		'r', "RUN",	0, "Run must be >= 1"},
+	{ 0 }
+};
+
+struct args {
+	const char *prefix_filename;
+	const char *output_filename;
+	int force_addr;
+	int shuffle;
+	uint64_t synthetic;
+	int xia;
+	int nnodes;
+	int run;
+};
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+	struct args *args = state->input;
+
+	switch (key) {
+	case 'p':
+		args->prefix_filename = arg;
+		break;
+
+	case 'o':
+		args->output_filename = arg;
+		break;
+
+	case 'a':
+		args->force_addr = 1;
+		break;
+
+	case 's':
+		args->shuffle = 1;
+		break;
+
+	case 'N':
+		args->synthetic = arg_to_long(state, arg);
+		if (args->synthetic < 1)
+			argp_error(state, "Number of prefixes must be >= 1");
+		break;
+
+	case 'X':
+		args->xia = 1;
+		args->force_addr = 1;
+		break;
+
+	case 'n':
+		args->nnodes = arg_to_long(state, arg);
+		if (args->nnodes < 2)
+			argp_error(state, "Number of nodes must be >= 2");
+		break;
+
+	case 'r':
+		args->run = arg_to_long(state, arg);
+		if (args->run < 1)
+			argp_error(state,"Run must be >= 1");
+		break;
+
+	case ARGP_KEY_ARG:
+		argp_error(state, "There is no argument");
+		break;
+
+	case ARGP_KEY_END:
+		if (!args->output_filename)
+			argp_error(state, "Option --output is required");
+		break;
+
+	default:
+		return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+
+static struct argp argp = {options, parse_opt, NULL, doc};
+
+int main(int argc, char **argv)
+{
+	struct args args = {
+		/* Defaults. */
+		.prefix_filename	= "prefix",
+		.output_filename	= NULL,
+		.force_addr		= 0,
+		.shuffle		= 0,
+		.synthetic		= 0,
+		.xia			= 0,
+		.nnodes			= 3,
+		.run			= 1,
+	};
+
+	struct seed s1, s2, node_seed;
+	struct net_prefix *prefixes;
+	struct prefix_table table;
+	uint64_t prefixes_count;
+	int stack;
+
+	/* Read parameters. */
+	argp_parse(&argp, argc, argv, 0, NULL, &args);
+
+	stack = args.xia ? PREFIX_TABLE_XIA : PREFIX_TABLE_IP;
+	printf_fsh(args.synthetic ? "Generating prefixes... " :
+		"Converting prefixes... ");
+	if (args.synthetic) {
+		/* Generate as pw and rk do; they need no shuffling. */
+		load_seeds(args.run, args.nnodes, 1, &s1, &s2, &node_seed);
+		prefixes_count = args.synthetic;
+		prefixes = generate_prefixes(prefixes_count, stack,
+			s1.seeds, SEED_UINT32_N, args.force_addr);
+		args.shuffle = 1;
+	} else if (args.shuffle) {
+		/* Shuffle as pw and rk do. */
+		load_seeds(args.run, args.nnodes, 1, &s1, &s2, &node_seed);
+		prefixes = load_file_as_shuffled_addrs(args.prefix_filename,
+			&prefixes_count, s1.seeds, SEED_UINT32_N,
+			args.force_addr);
+	} else {
+		prefixes = load_file_as_addrs(args.prefix_filename,
+			&prefixes_count, args.force_addr);
+	}
+	if (!prefixes_count)
+		errx(1, "Prefix file `%s' is empty", args.prefix_filename);
+	init_prefix_table(&table, stack, prefixes, prefixes_count);
+	free_net_prefix(prefixes);
+	write_prefix_file(args.output_filename, &table,
+		s1.seeds, args.shuffle ? SEED_UINT32_N : 0, args.force_addr);
+	printf_fsh("%" PRIu64 " prefixes DONE\n", prefixes_count);
+
+	end_prefix_table(&table);
+	return 0;
+}
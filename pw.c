@@ -1,17 +1,25 @@
 /* Packet writer. */
 
+#define _GNU_SOURCE		/* pthread_attr_setaffinity_np()	*/
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <err.h>
 #include <argp.h>
 #include <math.h>
+#include <sched.h>
+#include <pthread.h>
 
 #include <utils.h>
 #include <seeds.h>
 #include <rdist.h>
 #include <strarray.h>
 #include <sndpkt.h>
+#include <pace.h>
+#include <shmem.h>
+#include <churn.h>
+#include <sketch.h>
 
 /* Argp's global variables. */
 const char *argp_program_version = "Packet writer 1.0";
@@ -23,7 +31,64 @@ static struct argp_option options[] = {
 	{"prefix",	'p', "FILE",	0, "Name of prefix file"},
 	{"prefix-limit", 'x', "N",	0,
 		"Consider only the first N entries of the prefix file *after* shuffling it"},
+	{"synthetic",	'N', "N",	0,
+		"Generate N random prefixes from the seeds of the run "
+		"instead of loading the prefix file"},
 	{"zipf",	'z', "EXP",	0, "Parameter s of Zipf distribution"},
+	{"popularity",	'y', "DIST",	0,
+		"Popularity of destinations {'zipf' (see --zipf and "
+		"--mandelbrot), 'uniform', 'pareto' (see --pareto-alpha), "
+		"'histogram' (see --histogram)}; all but 'zipf' require "
+		"sampler 'alias'"},
+	{"mandelbrot",	'q', "Q",	0,
+		"Shift q of the Zipf-Mandelbrot distribution; the weight of "
+		"rank i is 1 / (i + q)^s; it requires sampler 'alias' "
+		"unless q is 0"},
+	{"pareto-alpha", 'e', "ALPHA",	0,
+		"Shape of the Pareto distribution of popularities"},
+	{"histogram",	'H', "FILE",	0,
+		"File whose line i holds the observed count of rank i"},
+	{"sampler",	'g', "MODE",	0,
+		"Chose among 'alias' (endless stream of Zipf samples), "
+		"'rejinv' (as 'alias', but in constant memory for huge "
+		"prefix sets), 'cache' (repeats 30 * N precomputed "
+		"samples as older versions of pw), and 'pcache' (as 'cache', "
+		"but the samples are drawn on all CPUs, so they differ from "
+		"older versions) samplers"},
+	{"zipf-cache-dir", 'k', "DIR",	0,
+		"Keep the samples of samplers 'cache' and 'pcache' in a file "
+		"in DIR, and map the file on later runs with the same "
+		"parameters"},
+	{"shm",		'S', "NAME",	0,
+		"Attach the shuffled prefixes and, for samplers 'cache' and "
+		"'pcache', "
+		"the Zipf samples that pl(1) published under NAME instead "
+		"of building them; pl's --stack must match --daddr-type"},
+	{"repeat",	'P', "PROB",	0,
+		"Probability that a packet repeats a recent destination "
+		"instead of sampling a fresh one (LRU stack model)"},
+	{"stack-depth",	'D', "N",	0,
+		"Number of recent destinations that --repeat draws from; "
+		"it must be a power of 2"},
+	{"stack-zipf",	'Z', "EXP",	0,
+		"Parameter s of the Zipf distribution of the stack distances "
+		"of --repeat"},
+	{"flows",	'F', "N",	0,
+		"Interleave N concurrent flows; each flow goes to a single "
+		"destination; zero samples a destination per packet"},
+	{"flow-size",	'L', "DIST",	0,
+		"Distribution of the number of packets of flows {'pareto', "
+		"'lognormal'}"},
+	{"flow-mean",	'M', "PACKETS",	0, "Mean number of packets of flows"},
+	{"flow-shape",	'A', "SHAPE",	0,
+		"Shape of --flow-size; alpha (> 1) of 'pareto', or "
+		"sigma of 'lognormal'"},
+	{"churn-swaps",	'K', "K",	0,
+		"Swap K random pairs of Zipf ranks per second, so "
+		"the popularity of destinations changes gradually"},
+	{"churn-period", 'C', "SECONDS", 0,
+		"Reshuffle all Zipf ranks every SECONDS seconds, so "
+		"the popularity of destinations changes abruptly"},
 	{"stack",	's', "NET",	0,
 		"Chose between 'ip' and 'xia' stacks"},
 	{"ifname",	'i', "IF",	0,
@@ -34,31 +99,86 @@ static struct argp_option options[] = {
 		"Type of the destination address template {'ip', 'fb0', "
 		"'fb1', 'fb2', 'fb3', 'via'}"},
 	{"pkt-len",	'l', "LEN",	0, "Packet lenght in bytes"},
+	{"batch",	'c', "COUNT",	0,
+		"Number of packets handed to the kernel at once [1..64]"},
+	{"backend",	'b', "MODE",	0,
+		"Chose among 'socket' (one sendto() per packet), 'ring' "
+		"(PACKET_MMAP TX ring), and 'xdp' (AF_XDP socket; "
+		"thread i uses TX queue i) send backends"},
 	{"nnodes",	'n', "COUNT",	0,
 		"Number of nodes (= number of ports + 1)"},
 	{"node-id",	'd', "ID",	0,
 		"ID of this packet writer [1..(N-1)]"},
 	{"run",		'r', "RUN",	0, "Run must be >= 1"},
+	{"rate",	'R', "PPS",	0,
+		"Send PPS packets per second; 0 sends as fast as possible"},
+	{"arrivals",	'a', "MODEL",	0,
+		"Inter-arrival model of --rate {'constant', 'poisson', "
+		"'onoff'}"},
+	{"on-time",	'o', "SECONDS",	0,
+		"Mean duration of on periods of model 'onoff'"},
+	{"off-time",	'f', "SECONDS",	0,
+		"Mean duration of off periods of model 'onoff'"},
+	{"threads",	'T', "N",	0,
+		"Number of threads sending packets; each thread is pinned to "
+		"a CPU, and sends its own slice of the Zipf samples of "
+		"samplers 'cache' and 'pcache', or its own share of the "
+		"fixed chunks of samples of the other samplers, so the "
+		"samples do not depend on the number of threads"},
 	{"interactive",	'v', NULL,	0,
 		"Allow one to interactively control the number of packets sent"
 		},
+	{"analyze",	'W', "SAMPLES",	0,
+		"Instead of sending packets, draw SAMPLES destinations, and "
+		"report the number of unique destinations, the traffic "
+		"covered by the top-k destinations, and the hit rates of "
+		"LRU caches; rank churn is ignored"},
 	{ 0 }
 };
 
 struct args {
 	const char *prefix_filename;
 	uint64_t prefix_limit;
+	uint64_t synthetic;
 	double s;
+	const char *popularity;
+	double q;
+	double pareto_alpha;
+	const char *histogram;
+	int q_set;		/* --mandelbrot was given.		*/
+	int pareto_set;		/* --pareto-alpha was given.		*/
+	const char *sampler;
+	const char *zipf_cache_dir;
+	const char *shm_name;
+	double p_repeat;
+	long stack_depth;
+	double stack_s;
+	long flows;
+	const char *flow_size;
+	double flow_mean;
+	double flow_shape;
+	double churn_swaps;
+	double churn_period;
 	const char *stack;
 	const char *ifname;
 	unsigned char dst_mac[32];
 	int dst_mac_len;
 	const char *dst_addr_type;
 	int packet_len;
+	int batch;
+	const char *backend;
 	int nnodes;
 	int node_id;
 	int run;
+	double rate;
+	const char *arrivals;
+	double on_time;
+	double off_time;
+	int arrivals_set;	/* --arrivals was given.			*/
+	int onoff_set;		/* --on-time or --off-time was given.	*/
+	int threads;
 	int interactive;
+	uint64_t analyze;
 };
 
 /* XXX Copied from xiaconf/xip/utils.c. This function should go to
@@ -158,15 +278,117 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 			argp_error(state, "Prefix limit must be >= 1");
 		break;
 
-	case 'z': {
-		char *end;
-		args->s = strtod(arg, &end);
-		if (!*arg || *end)
-			argp_error(state, "'%s' is not a float", arg);
+	case 'N':
+		args->synthetic = arg_to_long(state, arg);
+		if (args->synthetic < 1)
+			argp_error(state, "Number of prefixes must be >= 1");
+		break;
+
+	case 'z':
+		args->s = arg_to_double(state, arg);
 		if (args->s < 0 || args->s == NAN || args->s == INFINITY)
 			argp_error(state,"Zipf must be >= 0");
 		break;
-	}
+
+	case 'y':
+		args->popularity = arg;
+		if (strcmp(arg, "zipf") && strcmp(arg, "uniform") &&
+			strcmp(arg, "pareto") && strcmp(arg, "histogram"))
+			argp_error(state, "Popularity must be either 'zipf', "
+				"'uniform', 'pareto', or 'histogram'");
+		break;
+
+	case 'q':
+		args->q = arg_to_double(state, arg);
+		if (!(args->q > -1 && args->q < INFINITY))
+			argp_error(state, "Shift must be > -1");
+		args->q_set = 1;
+		break;
+
+	case 'e':
+		args->pareto_alpha = arg_to_double(state, arg);
+		if (!(args->pareto_alpha > 0 &&
+			args->pareto_alpha < INFINITY))
+			argp_error(state, "Pareto shape must be > 0");
+		args->pareto_set = 1;
+		break;
+
+	case 'H':
+		args->histogram = arg;
+		break;
+
+	case 'g':
+		args->sampler = arg;
+		if (strcmp(arg, "alias") && strcmp(arg, "rejinv") &&
+			strcmp(arg, "cache") && strcmp(arg, "pcache"))
+			argp_error(state, "Sampler must be either 'alias', "
+				"'rejinv', 'cache', or 'pcache'");
+		break;
+
+	case 'k':
+		args->zipf_cache_dir = arg;
+		break;
+
+	case 'S':
+		args->shm_name = arg;
+		break;
+
+	case 'P':
+		args->p_repeat = arg_to_double(state, arg);
+		if (!(args->p_repeat >= 0 && args->p_repeat <= 1))
+			argp_error(state, "Probability must be in [0, 1]");
+		break;
+
+	case 'D':
+		args->stack_depth = arg_to_long(state, arg);
+		if (args->stack_depth < 1 ||
+			(args->stack_depth & (args->stack_depth - 1)))
+			argp_error(state, "Stack depth must be a power of 2");
+		break;
+
+	case 'Z':
+		args->stack_s = arg_to_double(state, arg);
+		if (!(args->stack_s >= 0 && args->stack_s < INFINITY))
+			argp_error(state, "Zipf must be >= 0");
+		break;
+
+	case 'F':
+		args->flows = arg_to_long(state, arg);
+		if (args->flows < 0)
+			argp_error(state, "Number of flows must be >= 0");
+		break;
+
+	case 'L':
+		args->flow_size = arg;
+		if (strcmp(arg, "pareto") && strcmp(arg, "lognormal"))
+			argp_error(state, "Flow size must be either 'pareto', "
+				"or 'lognormal'");
+		break;
+
+	case 'M':
+		args->flow_mean = arg_to_double(state, arg);
+		if (!(args->flow_mean >= 1 && args->flow_mean < INFINITY))
+			argp_error(state, "Mean flow size must be >= 1");
+		break;
+
+	case 'A':
+		args->flow_shape = arg_to_double(state, arg);
+		if (!(args->flow_shape >= 0 && args->flow_shape < INFINITY))
+			argp_error(state, "Flow shape must be >= 0");
+		break;
+
+	case 'K':
+		args->churn_swaps = arg_to_double(state, arg);
+		if (!(args->churn_swaps >= 0 && args->churn_swaps < INFINITY))
+			argp_error(state, "Swaps per second must be >= 0");
+		break;
+
+	case 'C':
+		args->churn_period = arg_to_double(state, arg);
+		if (!(args->churn_period >= 0 &&
+			args->churn_period < INFINITY))
+			argp_error(state, "Churn period must be >= 0");
+		break;
 
 	case 's':
 		args->stack = arg;
@@ -201,6 +423,21 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 			argp_error(state, "Packet lenght must be >= 1");
 		break;
 
+	case 'c':
+		args->batch = arg_to_long(state, arg);
+		if (args->batch < 1 || args->batch > SNDPKT_MAX_BATCH)
+			argp_error(state, "Batch must be in [1..%i]",
+				SNDPKT_MAX_BATCH);
+		break;
+
+	case 'b':
+		args->backend = arg;
+		if (strcmp(arg, "socket") && strcmp(arg, "ring") &&
+			strcmp(arg, "xdp"))
+			argp_error(state, "Backend must be either 'socket', "
+				"'ring', or 'xdp'");
+		break;
+
 	case 'n':
 		args->nnodes = arg_to_long(state, arg);
 		if (args->nnodes < 2)
@@ -219,10 +456,96 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 			argp_error(state,"Run must be >= 1");
 		break;
 
+	case 'R':
+		args->rate = arg_to_double(state, arg);
+		if (!(args->rate >= 0 && args->rate < INFINITY))
+			argp_error(state, "Rate must be >= 0");
+		break;
+
+	case 'a':
+		args->arrivals = arg;
+		args->arrivals_set = 1;
+		if (strcmp(arg, "constant") && strcmp(arg, "poisson") &&
+			strcmp(arg, "onoff"))
+			argp_error(state, "Arrivals must be either 'constant', "
+				"'poisson', or 'onoff'");
+		break;
+
+	case 'o':
+		args->on_time = arg_to_double(state, arg);
+		if (!(args->on_time > 0 && args->on_time < INFINITY))
+			argp_error(state, "On time must be > 0");
+		args->onoff_set = 1;
+		break;
+
+	case 'f':
+		args->off_time = arg_to_double(state, arg);
+		if (!(args->off_time >= 0 && args->off_time < INFINITY))
+			argp_error(state, "Off time must be >= 0");
+		args->onoff_set = 1;
+		break;
+
+	case 'T':
+		args->threads = arg_to_long(state, arg);
+		if (args->threads < 1)
+			argp_error(state, "Number of threads must be >= 1");
+		break;
+
 	case 'v':
 		args->interactive = 1;
 		break;
 
+	case 'W':
+		args->analyze = arg_to_long(state, arg);
+		if (args->analyze < 1)
+			argp_error(state, "Number of samples must be >= 1");
+		break;
+
+	case ARGP_KEY_END:
+		if (args->analyze && (args->interactive || args->threads > 1))
+			argp_error(state, "Option --analyze only supports "
+				"a single, non-interactive thread");
+		if (args->interactive && args->threads > 1)
+			argp_error(state,
+				"Interactive mode only supports a single thread");
+		if ((args->arrivals_set || args->onoff_set) &&
+			!(args->rate > 0))
+			argp_error(state, "Options --arrivals, --on-time, and "
+				"--off-time require a rate");
+		if (args->onoff_set && strcmp(args->arrivals, "onoff"))
+			argp_error(state, "Options --on-time and --off-time "
+				"require arrivals 'onoff'");
+		if (args->interactive && args->rate > 0)
+			argp_error(state,
+				"Interactive mode does not support a rate");
+		if ((strcmp(args->popularity, "zipf") || args->q != 0) &&
+			strcmp(args->sampler, "alias"))
+			argp_error(state, "Popularities other than Zipf "
+				"require sampler 'alias'");
+		if (!strcmp(args->popularity, "histogram") &&
+			!args->histogram)
+			argp_error(state, "Popularity 'histogram' requires "
+				"option --histogram");
+		if (args->histogram && strcmp(args->popularity, "histogram"))
+			argp_error(state, "Option --histogram requires "
+				"popularity 'histogram'");
+		if (args->q_set && strcmp(args->popularity, "zipf"))
+			argp_error(state, "Option --mandelbrot requires "
+				"popularity 'zipf'");
+		if (args->pareto_set && strcmp(args->popularity, "pareto"))
+			argp_error(state, "Option --pareto-alpha requires "
+				"popularity 'pareto'");
+		if (!strcmp(args->flow_size, "pareto") &&
+			args->flow_shape <= 1)
+			argp_error(state, "Flow shape of 'pareto' must be > 1");
+		if (args->shm_name && args->zipf_cache_dir)
+			argp_error(state, "Options --shm and --zipf-cache-dir "
+				"are mutually exclusive");
+		if (args->synthetic && (args->shm_name || args->prefix_limit))
+			argp_error(state, "Option --synthetic excludes "
+				"options --shm and --prefix-limit");
+		break;
+
 	default:
 		return ARGP_ERR_UNKNOWN;
 	}
@@ -260,32 +583,458 @@ static int ask_count(void)
 	return n;
 }
 
+/* Tags to derive the seeds of the streams of each worker
+ * from @node_seed; see derive_seed().
+ */
+#define PACE_SEED_TAG	0x10000
+#define ZIPF_SEED_TAG	0x20000
+#define LRU_SEED_TAG	0x30000
+#define CHURN_SEED_TAG	0x40000
+#define FLOW_SEED_TAG	0x50000
+
+/* Number of samples of each chunk of the fresh destinations of samplers
+ * 'alias' and 'rejinv'; see struct worker.
+ */
+#define ZIPF_CHUNK	(1L << 16)
+
+struct worker {
+	/* Number of packets sent so far.
+	 * Only the worker writes it, but the main thread reads it, so
+	 * keep each counter in its own cache line.
+	 */
+	uint64_t sent __attribute__((aligned(64)));
+
+	pthread_t thread;
+	int batch;
+	double rate;		/* Zero means as fast as possible. */
+	const char *arrivals;
+	double on_time;
+	double off_time;
+	struct seed pace_seed;
+	struct pace pace;
+	struct sndpkt_engine engine;
+
+	/* Destinations come from sampling @zalias or @zrejinv, whichever
+	 * is not NULL, with @zunif. Otherwise, they come from a slice of
+	 * the Zipf cache.
+	 *
+	 * Samples of @zalias and @zrejinv form a single sequence cut into
+	 * chunks of ZIPF_CHUNK samples. Chunk c has its own stream derived
+	 * from @zseed, and worker (c % number of workers) sends it, so
+	 * the chunks, as the cache slices, do not depend on --threads.
+	 */
+	struct zipf_cache zslice;
+	struct alias_table *zalias;
+	struct zipf_rejinv *zrejinv;
+	struct unif_state zunif;
+	struct seed zseed;
+	uint32_t zchunk;	/* Next chunk of this worker.		*/
+	int zstride;		/* Number of workers.			*/
+	long zleft;		/* Samples left in the current chunk.	*/
+	struct prefix_table *prefixes;
+	struct churn *churn;	/* Maps ranks to prefixes unless NULL. */
+	int churn_reader;	/* Reader number of @churn.		*/
+
+	/* When @p_repeat is positive, packets repeat recent destinations
+	 * of @lru with probability @p_repeat.
+	 */
+	double p_repeat;
+	struct lru_stack lru;
+	struct unif_state lunif;
+
+	/* When @use_flows is true, packets belong to the flows of @flows. */
+	int use_flows;
+	struct flow_table flows;
+	struct unif_state funif;
+};
+
+/* Seed @w->zunif for the next chunk of @w; see struct worker. */
+static void start_zipf_chunk(struct worker *w)
+{
+	struct seed chunk_seed;
+
+	derive_seed(&w->zseed, w->zchunk, &chunk_seed);
+	init_unif(&w->zunif, chunk_seed.seeds, SEED_UINT32_N);
+	w->zchunk += w->zstride;
+	w->zleft = ZIPF_CHUNK;
+}
+
+/* Return the index in [1..n] of a fresh destination of @w. */
+static inline long sample_fresh(struct worker *w)
+{
+	if (!w->zalias && !w->zrejinv)
+		return sample_zipf_cache(&w->zslice);
+
+	if (!w->zleft) {
+		end_unif(&w->zunif);
+		start_zipf_chunk(w);
+	}
+	w->zleft--;
+	if (w->zalias)
+		return sample_alias(w->zalias, &w->zunif);
+	return sample_zipf_rejinv(w->zrejinv, &w->zunif);
+}
+
+/* Return the index in [1..n] of a new destination of @w; that is,
+ * a recent destination, or a fresh one.
+ */
+static inline long sample_new(struct worker *w)
+{
+	long index = 0;
+
+	if (w->p_repeat > 0)
+		index = sample_lru_stack(&w->lru, &w->lunif);
+	if (!index) {
+		index = sample_fresh(w);
+		if (w->churn)
+			index = churn_rank(w->churn, index);
+		if (w->p_repeat > 0)
+			push_lru_stack(&w->lru, index);
+	}
+	return index;
+}
+
+/* Return the index in [1..n] of the next destination of @w. */
+static inline long sample_dst_index(struct worker *w)
+{
+	long index;
+
+	if (w->use_flows) {
+		index = sample_flow(&w->flows, &w->funif);
+		if (!index) {
+			index = sample_new(w);
+			start_flow(&w->flows, index, &w->funif);
+		}
+	} else {
+		index = sample_new(w);
+	}
+	return index;
+}
+
+/* Return the address of the next destination of @w.
+ *
+ * The address is prefetched, so when a whole batch of destinations is
+ * sampled before the send backend reads them, the misses on
+ * large prefix arrays overlap instead of stalling each packet.
+ */
+static inline union net_addr *sample_dst(struct worker *w)
+{
+	union net_addr *dst = prefix_table_addr(w->prefixes,
+		sample_dst_index(w) - 1);
+	__builtin_prefetch(dst);
+	return dst;
+}
+
+/* Largest k of the top-k coverage of analyze(). */
+#define ANALYZE_TOP_K		10000
+/* Bound on the entries of each simulated LRU cache of analyze(). */
+#define ANALYZE_LRU_SIM		8192
+
+/* Report the working set of the destinations of @w out of @n ones
+ * over @samples samples.
+ */
+static void analyze(struct worker *w, uint64_t samples, long n)
+{
+	struct hll hll;
+	struct space_saving ss;
+	struct lru_sim *sims;
+	static const int marks[] = {1, 2, 5};
+	uint64_t i, decade = 1, checkpoint = 1, covered = 0, covered_low = 0;
+	long k, nsims = 0, size;
+	int step = 0;
+
+	init_hll(&hll);
+	init_space_saving(&ss, 10 * ANALYZE_TOP_K);
+	for (size = 10; size < n; size *= 10)
+		nsims++;
+	sims = malloc(sizeof(*sims) * (nsims ? nsims : 1));
+	assert(sims);
+	for (k = 0, size = 10; k < nsims; k++, size *= 10)
+		init_lru_sim(&sims[k], size, ANALYZE_LRU_SIM);
+
+	printf("Unique destinations (HyperLogLog, %.1f%% error):\n",
+		104.0 / sqrt(1 << HLL_BITS));
+	printf("%15s %15s\n", "samples", "unique");
+	for (i = 1; i <= samples; i++) {
+		uint64_t dst = sample_dst_index(w);
+		uint64_t hash = hash_dst(dst);
+
+		hll_add(&hll, hash);
+		space_saving_add(&ss, dst, hash);
+		for (k = 0; k < nsims; k++)
+			lru_sim_add(&sims[k], dst, hash);
+
+		/* Checkpoints at 1, 2, 5, 10, 20, 50, ... samples. */
+		if (i == checkpoint || i == samples) {
+			printf("%15" PRIu64 " %15.0f\n", i, hll_count(&hll));
+			if (++step == 3) {
+				step = 0;
+				decade *= 10;
+			}
+			checkpoint = decade * marks[step];
+		}
+	}
+
+	/* The counts of space-saving are upper bounds, and
+	 * the counts minus their errors are lower bounds.
+	 */
+	printf("\nTraffic covered by the top-k destinations "
+		"(space-saving, %li counters):\n", ss.m);
+	printf("%15s %15s %15s\n", "k", "lower bound", "upper bound");
+	for (k = 0, size = 1; k < ss.m; k++) {
+		struct ss_counter *c = space_saving_top(&ss, k);
+		int last = k + 1 == ss.m || !space_saving_top(&ss, k + 1)->count;
+
+		if (!c->count)
+			break;
+		covered += c->count;
+		covered_low += c->count - c->error;
+		if (k + 1 == size || last) {
+			printf("%15li %15.4f %15.4f\n", k + 1,
+				(double)covered_low / samples,
+				(double)covered / samples);
+			if (last || size >= ANALYZE_TOP_K)
+				break;
+			size *= 10;
+		}
+	}
+
+	printf("\nHit rates of LRU caches (SHARDS, %i entries per cache):\n",
+		ANALYZE_LRU_SIM);
+	printf("%15s %15s %15s\n", "entries", "hit rate", "sampling rate");
+	for (k = 0; k < nsims; k++) {
+		printf("%15li %15.4f %15.6f\n", sims[k].size,
+			lru_sim_hit_rate(&sims[k]),
+			(double)sims[k].sim_size / sims[k].size);
+		end_lru_sim(&sims[k]);
+	}
+	free(sims);
+	end_space_saving(&ss);
+}
+
+static void send_interactively(struct worker *w)
+{
+	union net_addr *dst = sample_dst(w);
+	double count = 0.0;
+	double to_send;
+
+	if (w->churn)
+		churn_offline(w->churn, w->churn_reader);
+	to_send = ask_count();
+	if (w->churn)
+		churn_quiescent(w->churn, w->churn_reader);
+
+	while (1) {
+		if (!sndpkt_send(&w->engine, dst))
+			continue; /* No packet sent. */
+		sndpkt_flush(&w->engine);
+		dst = sample_dst(w);
+		count++;
+
+		printf("Packet %.0f sent\n", count);
+		if (count >= to_send) {
+			/* Do not hold reshuffles while waiting for input. */
+			if (w->churn)
+				churn_offline(w->churn, w->churn_reader);
+			to_send = count + ask_count();
+		}
+		if (w->churn)
+			churn_quiescent(w->churn, w->churn_reader);
+	}
+}
+
+static void *send_batches(void *arg)
+{
+	struct worker *w = arg;
+	union net_addr *dsts[SNDPKT_MAX_BATCH];
+	int queued = 0;
+
+	assert(w->batch >= 1 && w->batch <= SNDPKT_MAX_BATCH);
+	if (w->rate > 0) {
+		/* The bucket holds 10ms of packets, so short stalls
+		 * do not reduce the long-term rate.
+		 */
+		uint64_t depth = w->rate * 0.01;
+		if (depth < w->batch)
+			depth = w->batch;
+
+		if (!strcmp(w->arrivals, "constant"))
+			init_pace(&w->pace, w->rate, depth);
+		else if (!strcmp(w->arrivals, "poisson"))
+			init_pace_poisson(&w->pace, w->rate, depth,
+				w->pace_seed.seeds, SEED_UINT32_N);
+		else if (!strcmp(w->arrivals, "onoff"))
+			init_pace_onoff(&w->pace, w->rate, depth,
+				w->on_time, w->off_time,
+				w->pace_seed.seeds, SEED_UINT32_N);
+		else
+			assert(0);
+	}
+
+	while (1) {
+		int to_send, sent;
+
+		/* Top up the destination vector; see sample_dst(). */
+		for (; queued < w->batch; queued++)
+			dsts[queued] = sample_dst(w);
+		if (w->churn)
+			churn_quiescent(w->churn, w->churn_reader);
+
+		to_send = queued;
+		if (w->rate > 0) {
+			/* When behind schedule, send whole batches. */
+			uint64_t tokens = pace_wait(&w->pace);
+			if (tokens < to_send)
+				to_send = tokens;
+		}
+
+		sent = sndpkt_send_batch(&w->engine, dsts, to_send);
+		if (!sent)
+			continue; /* No packet sent. */
+		if (w->rate > 0)
+			pace_consume(&w->pace, sent);
+
+		/* Keep the destinations not sent for the next batch,
+		 * so the sequence of destinations is preserved.
+		 */
+		queued -= sent;
+		memmove(dsts, dsts + sent, queued * sizeof(dsts[0]));
+		__atomic_store_n(&w->sent, w->sent + sent, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+/* Pin the @i-th worker to the @i-th CPU this process can run on. */
+static void pin_worker(pthread_attr_t *attr, int i)
+{
+	cpu_set_t allowed, cpu;
+	int count, cpu_id;
+
+	assert(!sched_getaffinity(0, sizeof(allowed), &allowed));
+	count = CPU_COUNT(&allowed);
+	assert(count > 0);
+	i %= count;
+
+	for (cpu_id = 0; ; cpu_id++) {
+		if (!CPU_ISSET(cpu_id, &allowed))
+			continue;
+		if (!i--)
+			break;
+	}
+
+	CPU_ZERO(&cpu);
+	CPU_SET(cpu_id, &cpu);
+	assert(!pthread_attr_setaffinity_np(attr, sizeof(cpu), &cpu));
+}
+
+static void start_workers(struct worker *workers, int n)
+{
+	int i;
+	for (i = 0; i < n; i++) {
+		pthread_attr_t attr;
+		assert(!pthread_attr_init(&attr));
+		if (n > 1)
+			pin_worker(&attr, i);
+		if (pthread_create(&workers[i].thread, &attr, send_batches,
+			&workers[i]))
+			errx(1, "Can't create thread of worker %i", i);
+		assert(!pthread_attr_destroy(&attr));
+	}
+}
+
+static uint64_t total_sent(struct worker *workers, int n)
+{
+	uint64_t total = 0;
+	int i;
+	for (i = 0; i < n; i++)
+		total += __atomic_load_n(&workers[i].sent, __ATOMIC_RELAXED);
+	return total;
+}
+
+/* Report the aggregated rate of all workers every 10 seconds.
+ * When @rate is positive, also report it as the target rate.
+ */
+static void report_rates(struct worker *workers, int n, double rate)
+{
+	uint64_t count = total_sent(workers, n);
+	double start = now();
+
+	while (1) {
+		uint64_t last_count = count;
+		double last_start = start;
+
+		nsleep(10.0);
+		count = total_sent(workers, n);
+		start = now();
+		if (rate > 0)
+			printf_fsh("%.1f pps (target %.1f pps)\n",
+				(count - last_count) / (start - last_start),
+				rate);
+		else
+			printf_fsh("%.1f pps\n",
+				(count - last_count) / (start - last_start));
+	}
+}
+
 int main(int argc, char **argv)
 {
 	struct args args = {
 		/* Defaults. */
 		.prefix_filename	= "prefix",
 		.prefix_limit		= 0,
+		.synthetic		= 0,
 		.s			= 1.0,
+		.popularity		= "zipf",
+		.q			= 0.0,
+		.pareto_alpha		= 1.0,
+		.histogram		= NULL,
+		.q_set			= 0,
+		.pareto_set		= 0,
+		.sampler		= "alias",
+		.zipf_cache_dir		= NULL,
+		.shm_name		= NULL,
+		.p_repeat		= 0.0,
+		.stack_depth		= 1024,
+		.stack_s		= 1.0,
+		.flows			= 0,
+		.flow_size		= "pareto",
+		.flow_mean		= 10.0,
+		.flow_shape		= 1.5,
+		.churn_swaps		= 0.0,
+		.churn_period		= 0.0,
 		.stack			= "ip",
 		.ifname			= "eth0",
 		.dst_mac		= {0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
 		.dst_mac_len		= 6,
 		.dst_addr_type		= "ip",
 		.packet_len		= 64,
+		.batch			= SNDPKT_MAX_BATCH,
+		.backend		= "socket",
 		.nnodes			= 3,
 		.node_id		= 1,
 		.run			= 1,
+		.rate			= 0.0,
+		.arrivals		= "constant",
+		.on_time		= 0.001,
+		.off_time		= 0.001,
+		.arrivals_set		= 0,
+		.onoff_set		= 0,
+		.threads		= 1,
 		.interactive		= 0,
+		.analyze		= 0,
 	};
 
 	struct seed s1, s2, node_seed;
 	struct net_prefix *prefixes;
+	struct prefix_table table;
 	uint64_t prefixes_count;
+	char shm_name[256], meta_name[256];
 	struct zipf_cache zcache;
-	struct sndpkt_engine engine;
-	double start, diff, count, to_send;
-	long index;
+	struct alias_table zalias;
+	struct zipf_rejinv zrejinv;
+	struct worker *workers;
+	struct churn churn;
+	int use_churn, use_cache, use_pcache, use_alias, stack, i;
 
 	/* Read parameters. */
 	argp_parse(&argp, argc, argv, 0, NULL, &args);
@@ -300,59 +1049,196 @@ int main(int argc, char **argv)
 
 	/* PW does not use seed @s2. */
 
-	/* Load and shuffle destination addresses. */
-	prefixes = load_file_as_shuffled_addrs(args.prefix_filename,
-		&prefixes_count, s1.seeds, SEED_UINT32_N, 1);
+	/* Load and shuffle destination addresses, and keep only
+	 * the compact prefixes of the stack.
+	 */
+	stack = strcmp(args.dst_addr_type, "ip") ?
+		PREFIX_TABLE_XIA : PREFIX_TABLE_IP;
+	if (args.synthetic) {
+		prefixes_count = args.synthetic;
+		prefixes = generate_prefixes(prefixes_count, stack,
+			s1.seeds, SEED_UINT32_N, 1);
+		init_prefix_table(&table, stack, prefixes, prefixes_count);
+		free_net_prefix(prefixes);
+	} else if (args.shm_name) {
+		/* Point at the published table; there is no copy. */
+		if (snprintf(shm_name, sizeof(shm_name), SHMEM_PREFIX_NAME,
+			args.shm_name) >= sizeof(shm_name) ||
+			snprintf(meta_name, sizeof(meta_name),
+			SHMEM_PREFIX_META_NAME, args.shm_name) >=
+			sizeof(meta_name))
+			errx(1, "Name `%s' is too long", args.shm_name);
+		prefixes_count = attach_prefix_table(&table, stack, shm_name,
+			meta_name, args.prefix_filename, args.prefix_limit,
+			s1.seeds, SEED_UINT32_N, 1);
+	} else {
+		/* Stream the prefix file, so it need not fit in memory. */
+		prefixes_count = load_prefix_table(&table, stack,
+			args.prefix_filename, args.prefix_limit,
+			s1.seeds, SEED_UINT32_N, 1);
+	}
 	if (!prefixes_count)
 		err(1, "Prefix file `%s' is empty", args.prefix_filename);
-	if (args.prefix_limit) {
-		if (args.prefix_limit > prefixes_count)
-			err(1, "Option --prefix-limit=%" PRIu64 " "
-				"is larger than the number of entries in "
-				"the prefix file `%s' (= %" PRIu64 ")",
-				args.prefix_limit, args.prefix_filename,
+	if (args.prefix_limit > prefixes_count)
+		err(1, "Option --prefix-limit=%" PRIu64 " "
+			"is larger than the number of entries in "
+			"the prefix file `%s' (= %" PRIu64 ")",
+			args.prefix_limit, args.prefix_filename,
+			prefixes_count);
+	prefixes_count = table.n;
+
+	use_pcache = !strcmp(args.sampler, "pcache");
+	use_cache = use_pcache || !strcmp(args.sampler, "cache");
+	use_alias = !strcmp(args.sampler, "alias");
+	if (use_cache) {
+		/* Cache Zipf sampling. */
+		printf_fsh("Initializing Zipf cache... ");
+		if (args.shm_name) {
+			if (snprintf(shm_name, sizeof(shm_name),
+				SHMEM_ZIPF_NAME, args.shm_name,
+				args.node_id) >= sizeof(shm_name))
+				errx(1, "Name `%s' is too long",
+					args.shm_name);
+			init_zipf_cache_shmem(&zcache, shm_name,
+				prefixes_count * 30, args.s, prefixes_count,
+				node_seed.seeds, SEED_UINT32_N, use_pcache);
+		} else if (args.zipf_cache_dir)
+			init_zipf_cache_file(&zcache, args.zipf_cache_dir,
+				prefixes_count * 30, args.s, prefixes_count,
+				node_seed.seeds, SEED_UINT32_N, use_pcache);
+		else
+			init_zipf_cache(&zcache, prefixes_count * 30, args.s,
+				prefixes_count, node_seed.seeds,
+				SEED_UINT32_N, use_pcache);
+		printf_fsh("DONE\n");
+		/*
+		print_zipf_cache(&zcache);
+		*/
+	} else if (use_alias) {
+		struct popularity pop;
+
+		printf_fsh("Initializing alias table... ");
+		if (!strcmp(args.popularity, "zipf"))
+			init_popularity_zipf(&pop, args.s, args.q,
+				prefixes_count);
+		else if (!strcmp(args.popularity, "uniform"))
+			init_popularity_uniform(&pop, prefixes_count);
+		else if (!strcmp(args.popularity, "pareto"))
+			init_popularity_pareto(&pop, args.pareto_alpha,
 				prefixes_count);
-		prefixes_count = args.prefix_limit;
+		else if (!strcmp(args.popularity, "histogram"))
+			init_popularity_histogram(&pop, args.histogram,
+				prefixes_count);
+		else
+			assert(0);
+		init_popularity_alias(&zalias, &pop);
+		end_popularity(&pop);
+		printf_fsh("DONE\n");
+	} else {
+		init_zipf_rejinv(&zrejinv, args.s, prefixes_count);
 	}
 
-	/* Cache Zipf sampling. */
-	printf_fsh("Initializing Zipf cache... ");
-	init_zipf_cache(&zcache, prefixes_count * 30, args.s, prefixes_count,
-		node_seed.seeds, SEED_UINT32_N);
-	printf_fsh("DONE\n");
-	/*
-	print_zipf_cache(&zcache);
-	*/
+	use_churn = args.churn_swaps > 0 || args.churn_period > 0;
+	if (use_churn) {
+		struct seed churn_seed;
+		derive_seed(&node_seed, CHURN_SEED_TAG, &churn_seed);
+		init_churn(&churn, prefixes_count, args.churn_swaps,
+			args.churn_period, churn_seed.seeds, SEED_UINT32_N,
+			args.threads);
+	}
 
 	/* Sample destinations and send packets out. */
-	init_sndpkt_engine(&engine, args.stack, args.ifname, args.packet_len,
-		args.dst_mac, args.dst_mac_len, args.dst_addr_type);
-	index = sample_zipf_cache(&zcache);
-	count = 0.0;
-	to_send = args.interactive ? ask_count() : 0.0;
-	start = now();
-	while (1) {
-		if (!sndpkt_send(&engine, &prefixes[index - 1].addr))
-			continue; /* No packet sent. */
-		index = sample_zipf_cache(&zcache);
-		count++;
-
-		if (!args.interactive) {
-			diff = now() - start;
-			if (diff >= 10.0) {
-				printf_fsh("%.1f pps\n", count / diff);
-				count = 0.0;
-				start = now();
-			}
+	if (posix_memalign((void **)&workers, 64,
+		sizeof(*workers) * args.threads))
+		errx(1, "Can't allocate workers");
+	for (i = 0; i < args.threads; i++) {
+		struct worker *w = &workers[i];
+		w->sent = 0;
+		w->batch = args.batch;
+		w->rate = args.rate / args.threads;
+		w->arrivals = args.arrivals;
+		w->on_time = args.on_time;
+		w->off_time = args.off_time;
+		derive_seed(&node_seed, PACE_SEED_TAG + i, &w->pace_seed);
+		w->prefixes = &table;
+		w->churn = use_churn ? &churn : NULL;
+		w->churn_reader = i;
+		w->use_flows = args.flows > 0;
+		if (w->use_flows) {
+			struct seed flow_seed;
+			derive_seed(&node_seed, FLOW_SEED_TAG + i, &flow_seed);
+			init_unif(&w->funif, flow_seed.seeds, SEED_UINT32_N);
+			init_flow_table(&w->flows, args.flows,
+				!strcmp(args.flow_size, "pareto") ?
+				FLOW_SIZE_PARETO : FLOW_SIZE_LOGNORMAL,
+				args.flow_mean, args.flow_shape);
+		}
+		w->zalias = NULL;
+		w->zrejinv = NULL;
+		if (use_cache) {
+			slice_zipf_cache(&w->zslice, &zcache, i,
+				args.threads);
 		} else {
-			printf("Packet %.0f sent\n", count);
-			if (count >= to_send)
-				to_send = count + ask_count();
+			/* Worker i starts with chunk i. */
+			derive_seed(&node_seed, ZIPF_SEED_TAG, &w->zseed);
+			w->zchunk = i;
+			w->zstride = args.threads;
+			start_zipf_chunk(w);
+			if (use_alias)
+				w->zalias = &zalias;
+			else
+				w->zrejinv = &zrejinv;
+		}
+		w->p_repeat = args.p_repeat;
+		if (w->p_repeat > 0) {
+			struct seed lru_seed;
+			derive_seed(&node_seed, LRU_SEED_TAG + i, &lru_seed);
+			init_unif(&w->lunif, lru_seed.seeds, SEED_UINT32_N);
+			init_lru_stack(&w->lru, args.stack_depth,
+				args.p_repeat, args.stack_s);
 		}
+		if (!args.analyze)
+			init_sndpkt_engine(&w->engine, args.backend,
+				args.stack, args.ifname, i, args.packet_len,
+				args.dst_mac, args.dst_mac_len,
+				args.dst_addr_type);
 	}
 
-	end_sndpkt_engine(&engine);
-	end_zipf_cache(&zcache);
-	free_net_prefix(prefixes);
+	/* Rank churn runs in real time, whereas analysis runs as fast as
+	 * it can, so churn is not started for analysis.
+	 */
+	if (use_churn && !args.analyze)
+		start_churn(&churn);
+	if (args.analyze) {
+		analyze(&workers[0], args.analyze, prefixes_count);
+	} else if (args.interactive) {
+		send_interactively(&workers[0]);
+	} else {
+		start_workers(workers, args.threads);
+		report_rates(workers, args.threads, args.rate);
+	}
+
+	for (i = 0; i < args.threads; i++) {
+		if (!args.analyze)
+			end_sndpkt_engine(&workers[i].engine);
+		if (!use_cache)
+			end_unif(&workers[i].zunif);
+		if (workers[i].p_repeat > 0) {
+			end_lru_stack(&workers[i].lru);
+			end_unif(&workers[i].lunif);
+		}
+		if (workers[i].use_flows) {
+			end_flow_table(&workers[i].flows);
+			end_unif(&workers[i].funif);
+		}
+	}
+	free(workers);
+	if (use_churn)
+		end_churn(&churn);
+	if (use_cache)
+		end_zipf_cache(&zcache);
+	else if (use_alias)
+		end_alias_table(&zalias);
+	end_prefix_table(&table);
 	return 0;
 }
@@ -1,18 +1,103 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
+#include <utils.h>
 #include <rdist.h>
+#include <shmem.h>
 
-/* Reference: http://en.wikipedia.org/wiki/Zipf%27s_law */
-struct zipf_state {
-	double s;
-	long n;
-	double *cdf;
+/* Large Zipf tables are built in chunks of ZIPF_CHUNK items on all
+ * CPUs of count_cpus(). Chunks have a fixed size, so the results do not
+ * depend on the number of CPUs.
+ */
+#define ZIPF_CHUNK	(1L << 20)
+
+static inline long count_chunks(long n)
+{
+	return (n + ZIPF_CHUNK - 1) / ZIPF_CHUNK;
+}
+
+struct zipf_cdf_job {
+	struct zipf_state *state;
+	/* Sum of the terms of the chunks after chunk c. */
+	double *offset;
+	double hns;	/* H_n^s */
 };
 
-static void init_zipf_cdf(struct zipf_state *state)
+/* Set @cdf[i] to the sum of the terms of chunk @c from i on, and
+ * @offset[c] to the sum of all terms of chunk @c.
+ */
+static void sum_zipf_chunk(void *arg, long c)
+{
+	struct zipf_cdf_job *job = arg;
+	struct zipf_state *state = job->state;
+	long lo = c * ZIPF_CHUNK;
+	long i = lo + ZIPF_CHUNK < state->n ? lo + ZIPF_CHUNK : state->n;
+	double sum = 0.0;
+
+	/* Add terms from smallest to largest to preserve precision. */
+	while (--i >= lo) {
+		sum += 1.0 / pow(i + 1.0, state->s);
+		state->cdf[i] = sum;
+	}
+	job->offset[c] = sum;
+}
+
+static void norm_zipf_chunk(void *arg, long c)
+{
+	struct zipf_cdf_job *job = arg;
+	struct zipf_state *state = job->state;
+	long lo = c * ZIPF_CHUNK;
+	long hi = lo + ZIPF_CHUNK < state->n ? lo + ZIPF_CHUNK : state->n;
+	long i;
+
+	for (i = lo; i < hi; i++)
+		state->cdf[i] = 1.0 -
+			((state->cdf[i] + job->offset[c]) / job->hns);
+}
+
+/* A parallel suffix sum: chunks are summed in parallel, and
+ * their sums are added from the last (i.e. smallest) chunk to the first
+ * one, so terms are still added from smallest to largest.
+ */
+static void init_zipf_cdf_parallel(struct zipf_state *state)
+{
+	long chunks = count_chunks(state->n);
+	struct zipf_cdf_job job;
+	double sum = 0.0;
+	long c;
+
+	job.state = state;
+	job.offset = malloc(sizeof(job.offset[0]) * chunks);
+	assert(job.offset);
+
+	run_chunks(sum_zipf_chunk, &job, chunks);
+	for (c = chunks - 1; c >= 0; c--) {
+		double chunk_sum = job.offset[c];
+		job.offset[c] = sum;
+		sum += chunk_sum;
+	}
+	job.hns = sum;
+	run_chunks(norm_zipf_chunk, &job, chunks);
+
+	free(job.offset);
+	assert(state->cdf[0] == 0.0);
+}
+
+/* The serial sum of older versions; the CDFs of both sums only differ
+ * for more than ZIPF_CHUNK items, but the serial sum is kept for
+ * the samples of sampler 'cache' to match older versions bit by bit.
+ */
+static void init_zipf_cdf_serial(struct zipf_state *state)
 {
 	long i;
 	double hns = 0.0; /* H_n^s */
@@ -34,6 +119,50 @@ static void init_zipf_cdf(struct zipf_state *state)
 	assert(state->cdf[0] == 0.0);
 }
 
+/* RETURN the largest i such that @cdf[i] <= t. */
+static long search_zipf_cdf(struct zipf_state *state, double t)
+{
+	long a = 0;
+	long b = state->n;
+
+	/* Invariant: @cdf[a] <= t, and @cdf[b] > t unless b == n. */
+	while (b - a >= 2) {
+		long c = (a + b) / 2;
+		if (state->cdf[c] <= t)
+			a = c;
+		else
+			b = c;
+	}
+	return a;
+}
+
+static void guide_zipf_chunk(void *arg, long c)
+{
+	struct zipf_state *state = arg;
+	long j = c * ZIPF_CHUNK;
+	long hi = j + ZIPF_CHUNK <= state->guide_size ? j + ZIPF_CHUNK :
+		state->guide_size + 1;
+	long i = search_zipf_cdf(state, (double)j / state->guide_size);
+
+	for (; j < hi; j++) {
+		double t = (double)j / state->guide_size;
+		while (i + 1 < state->n && state->cdf[i + 1] <= t)
+			i++;
+		state->guide[j] = i;
+	}
+}
+
+/* @guide[j] is the largest i such that @cdf[i] <= j / @guide_size. */
+static void init_zipf_guide(struct zipf_state *state)
+{
+	state->guide_size = state->n;
+	state->guide = malloc(sizeof(state->guide[0]) *
+		(state->guide_size + 1));
+	assert(state->guide);
+	run_chunks(guide_zipf_chunk, state,
+		count_chunks(state->guide_size + 1));
+}
+
 /* For debuging. */
 /*
 static void print_zipf_cdf(struct zipf_state *state)
@@ -45,32 +174,62 @@ static void print_zipf_cdf(struct zipf_state *state)
 }
 */
 
-/* When s == 0, it's just the uniform distribution. */
-static void init_zipf(struct zipf_state *state, double s, long n)
+static void init_zipf_state(struct zipf_state *state, double s, long n,
+	int parallel)
 {
 	assert(s >= 0.0);
 	assert(n >= 1);
+	assert(n <= UINT32_MAX);
 
 	state->s = s;
 	state->n = n;
 
 	state->cdf = malloc(sizeof(state->cdf[0]) * n);
 	assert(state->cdf);
-	init_zipf_cdf(state);
+	if (parallel)
+		init_zipf_cdf_parallel(state);
+	else
+		init_zipf_cdf_serial(state);
+	/* The two CDFs differ in their last bits, so their guide tables,
+	 * and hence their samples, may differ too; see sampler 'pcache'.
+	 */
+	init_zipf_guide(state);
+}
+
+void init_zipf(struct zipf_state *state, double s, long n)
+{
+	init_zipf_state(state, s, n, 1);
 }
 
-static void end_zipf(struct zipf_state *state)
+void end_zipf(struct zipf_state *state)
 {
-	void *p = state->cdf;
+	free(state->guide);
+	state->guide = NULL;
+	free(state->cdf);
 	state->cdf = NULL;
-	free(p);
 }
 
-/* IMPORTANT: z must be in [0, 1) OR [0, 1]. */
-static long sample_zipf(struct zipf_state *state, double z)
+long sample_zipf(struct zipf_state *state, double z)
 {
 	long a = 0;
 	long b = state->n - 1;
+	long j = (long)(z * state->guide_size);
+
+	/* Narrow the search down to the bucket of @z in the guide table.
+	 * The search below only requires that @cdf[a] <= z, and that
+	 * @cdf[b] > z unless b == n - 1. Checking both keeps
+	 * the samples exact even if rounding puts @z in a neighbour bucket.
+	 */
+	if (j < state->guide_size) {
+		long ga = state->guide[j];
+		long gb = state->guide[j + 1] + 1;
+		if (gb > b)
+			gb = b;
+		if (state->cdf[ga] <= z && (gb == b || state->cdf[gb] > z)) {
+			a = ga;
+			b = gb;
+		}
+	}
 
 	while (b - a >= 2) {
 		long c = (a + b) / 2;
@@ -91,38 +250,710 @@ static long sample_zipf(struct zipf_state *state, double z)
 	return a + 1;
 }
 
-void init_zipf_cache(struct zipf_cache *cache, long sample_size,
-	double s, long n, uint32_t *seeds, int len)
+void init_alias_table(struct alias_table *table, long n)
+{
+	assert(n >= 1);
+	assert(n <= UINT32_MAX);
+
+	table->n = n;
+	table->prob = malloc(sizeof(table->prob[0]) * n);
+	table->alias = malloc(sizeof(table->alias[0]) * n);
+	assert(table->prob && table->alias);
+}
+
+void build_alias_table(struct alias_table *table)
+{
+	long n = table->n;
+	double *prob = table->prob;
+	uint32_t *alias = table->alias;
+	/* Stack of small entries grows from the beginning of @work, and
+	 * stack of large entries grows from its end.
+	 */
+	uint32_t *work = malloc(sizeof(*work) * n);
+	long i, small = 0, large = 0;
+	double sum = 0.0;
+
+	assert(work);
+
+	/* Add terms from last to first, what preserves precision when
+	 * weights decrease as Zipf's do.
+	 */
+	for (i = n - 1; i >= 0; i--)
+		sum += prob[i];
+	assert(sum > 0.0);
+
+	for (i = 0; i < n; i++) {
+		prob[i] = prob[i] * n / sum;
+		alias[i] = i;
+		if (prob[i] < 1.0)
+			work[small++] = i;
+		else
+			work[n - ++large] = i;
+	}
+
+	while (small && large) {
+		uint32_t s = work[--small];
+		uint32_t l = work[n - large];
+
+		/* Fill what is missing of entry @s with outcome @l. */
+		alias[s] = l;
+		prob[l] = (prob[l] + prob[s]) - 1.0;
+		if (prob[l] < 1.0) {
+			large--;
+			work[small++] = l;
+		}
+	}
+
+	/* What is left is only off of 1.0 due to rounding. */
+	while (large)
+		prob[work[n - large--]] = 1.0;
+	while (small)
+		prob[work[--small]] = 1.0;
+
+	free(work);
+}
+
+void end_alias_table(struct alias_table *table)
+{
+	free(table->alias);
+	free(table->prob);
+	table->alias = NULL;
+	table->prob = NULL;
+}
+
+static double uniform_weight(struct popularity *pop, long rank)
+{
+	return 1.0;
+}
+
+static double zipf_weight(struct popularity *pop, long rank)
+{
+	return 1.0 / pow(rank + pop->q, pop->s);
+}
+
+static double pareto_weight(struct popularity *pop, long rank)
+{
+	return pow((rank - 0.5) / pop->n, -1.0 / pop->alpha);
+}
+
+static double histogram_weight(struct popularity *pop, long rank)
+{
+	return rank <= pop->counts_n ? pop->counts[rank - 1] : 0.0;
+}
+
+static void init_popularity(struct popularity *pop, long n,
+	double (*weight)(struct popularity *pop, long rank))
+{
+	assert(n >= 1);
+	memset(pop, 0, sizeof(*pop));
+	pop->weight = weight;
+	pop->n = n;
+}
+
+void init_popularity_uniform(struct popularity *pop, long n)
+{
+	init_popularity(pop, n, uniform_weight);
+}
+
+void init_popularity_zipf(struct popularity *pop, double s, double q,
+	long n)
+{
+	assert(s >= 0.0);
+	assert(q > -1.0);
+	init_popularity(pop, n, zipf_weight);
+	pop->s = s;
+	pop->q = q;
+}
+
+void init_popularity_pareto(struct popularity *pop, double alpha, long n)
+{
+	assert(alpha > 0.0);
+	init_popularity(pop, n, pareto_weight);
+	pop->alpha = alpha;
+}
+
+void init_popularity_histogram(struct popularity *pop, const char *filename,
+	long n)
+{
+	FILE *f = fopen(filename, "r");
+	long size = 0;
+	double count, sum = 0.0;
+	int rc;
+
+	if (!f)
+		err(1, "Can't open file `%s'", filename);
+	init_popularity(pop, n, histogram_weight);
+
+	while ((rc = fscanf(f, "%lf", &count)) == 1) {
+		if (!(count >= 0.0 && count < INFINITY))
+			errx(1, "Count %g on line %li of file `%s' is invalid",
+				count, pop->counts_n + 1, filename);
+		if (pop->counts_n >= n)
+			errx(1, "File `%s' has more counts than the %li "
+				"ranks", filename, n);
+		if (pop->counts_n == size) {
+			size = size ? 2 * size : 1024;
+			pop->counts = realloc(pop->counts,
+				sizeof(pop->counts[0]) * size);
+			assert(pop->counts);
+		}
+		pop->counts[pop->counts_n++] = count;
+		sum += count;
+	}
+	if (rc != EOF)
+		errx(1, "Line %li of file `%s' is not a count",
+			pop->counts_n + 1, filename);
+	assert(!fclose(f));
+	if (!(sum > 0.0))
+		errx(1, "File `%s' has no positive count", filename);
+}
+
+void end_popularity(struct popularity *pop)
+{
+	free(pop->counts);
+	pop->counts = NULL;
+}
+
+void init_popularity_alias(struct alias_table *table, struct popularity *pop)
 {
-	dsfmt_t mt;
-	struct zipf_state zipf;
 	long i;
 
+	init_alias_table(table, pop->n);
+	for (i = 0; i < pop->n; i++)
+		table->prob[i] = pop->weight(pop, i + 1);
+	build_alias_table(table);
+}
+
+void init_lru_stack(struct lru_stack *lru, long depth, double p_repeat,
+	double s)
+{
+	struct popularity pop;
+
+	assert(depth >= 1 && !(depth & (depth - 1)));
+	assert(p_repeat >= 0.0 && p_repeat <= 1.0);
+
+	lru->stack = malloc(sizeof(lru->stack[0]) * depth);
+	assert(lru->stack);
+	lru->depth = depth;
+	lru->top = 0;
+	lru->used = 0;
+	lru->p_repeat = p_repeat;
+	init_popularity_zipf(&pop, s, 0.0, depth);
+	init_popularity_alias(&lru->dist, &pop);
+	end_popularity(&pop);
+}
+
+void end_lru_stack(struct lru_stack *lru)
+{
+	end_alias_table(&lru->dist);
+	free(lru->stack);
+	lru->stack = NULL;
+}
+
+long sample_lru_stack(struct lru_stack *lru, struct unif_state *unif)
+{
+	long mask = lru->depth - 1;
+	long d, dst;
+
+	if (dsfmt_genrand_close_open(&unif->state) >= lru->p_repeat)
+		return 0;
+	d = sample_alias(&lru->dist, unif) - 1;
+	if (d >= lru->used)
+		return 0;
+
+	/* Move the destination at distance @d to the top. */
+	dst = lru->stack[(lru->top + d) & mask];
+	if (lru->top + d <= mask) {
+		memmove(&lru->stack[lru->top + 1], &lru->stack[lru->top],
+			d * sizeof(lru->stack[0]));
+	} else {
+		/* The entries wrap around the end of @stack. */
+		memmove(&lru->stack[1], &lru->stack[0],
+			(lru->top + d - lru->depth) * sizeof(lru->stack[0]));
+		lru->stack[0] = lru->stack[mask];
+		memmove(&lru->stack[lru->top + 1], &lru->stack[lru->top],
+			(mask - lru->top) * sizeof(lru->stack[0]));
+	}
+	lru->stack[lru->top] = dst;
+	return dst;
+}
+
+void init_flow_table(struct flow_table *table, long n, int size_dist,
+	double mean, double shape)
+{
+	assert(n >= 1);
+	assert(mean >= 1.0);
+
+	table->flows = calloc(n, sizeof(table->flows[0]));
+	assert(table->flows);
+	table->n = n;
+	table->slot = 0;
+	table->size_dist = size_dist;
+	table->mean = mean;
+	table->shape = shape;
+
+	switch (size_dist) {
+	case FLOW_SIZE_PARETO:
+		assert(shape > 1.0);
+		table->scale = mean * (shape - 1.0) / shape;
+		break;
+	case FLOW_SIZE_LOGNORMAL:
+		assert(shape >= 0.0);
+		table->scale = log(mean) - shape * shape / 2.0;
+		break;
+	default:
+		assert(0);
+	}
+}
+
+void end_flow_table(struct flow_table *table)
+{
+	free(table->flows);
+	table->flows = NULL;
+}
+
+/* Standard normal by the Box-Muller transform. */
+static double sample_normal(struct unif_state *unif)
+{
+	double u1 = 1.0 - dsfmt_genrand_close_open(&unif->state);
+	double u2 = dsfmt_genrand_close_open(&unif->state);
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+void start_flow(struct flow_table *table, long dst, struct unif_state *unif)
+{
+	struct flow *flow = &table->flows[table->slot];
+	double size;
+
+	assert(!flow->left);
+	assert(dst >= 1 && dst <= UINT32_MAX);
+
+	if (table->size_dist == FLOW_SIZE_PARETO)
+		size = table->scale / pow(1.0 -
+			dsfmt_genrand_close_open(&unif->state),
+			1.0 / table->shape);
+	else
+		size = exp(table->scale + table->shape * sample_normal(unif));
+
+	/* Round to a whole number of packets at random, so the mean
+	 * size is preserved, and count the current one.
+	 */
+	size = floor(size + dsfmt_genrand_close_open(&unif->state));
+	if (size < 1.0)
+		size = 1.0;
+	else if (size > UINT32_MAX)
+		size = UINT32_MAX;
+	flow->dst = dst;
+	flow->left = size - 1;
+}
+
+/* log1p(x) / x, which is well behaved near zero. */
+static inline double helper1(double x)
+{
+	if (fabs(x) > 1e-8)
+		return log1p(x) / x;
+	return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+/* expm1(x) / x, which is well behaved near zero. */
+static inline double helper2(double x)
+{
+	if (fabs(x) > 1e-8)
+		return expm1(x) / x;
+	return 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+}
+
+/* h(x) = 1 / x^s is the hat function. */
+static inline double rejinv_h(double s, double x)
+{
+	return exp(-s * log(x));
+}
+
+/* H(x) = (x^(1 - s) - 1) / (1 - s) is an integral of h(x). */
+static inline double rejinv_hint(double s, double x)
+{
+	double log_x = log(x);
+	return helper2((1.0 - s) * log_x) * log_x;
+}
+
+/* Inverse of H(x). */
+static inline double rejinv_hint_inv(double s, double x)
+{
+	double t = x * (1.0 - s);
+	if (t < -1.0)
+		t = -1.0; /* Limit value due to rounding errors. */
+	return exp(helper1(t) * x);
+}
+
+void init_zipf_rejinv(struct zipf_rejinv *zipf, double s, long n)
+{
+	assert(s >= 0.0);
+	assert(n >= 1);
+
+	zipf->s = s;
+	zipf->n = n;
+	zipf->h_x1 = rejinv_hint(s, 1.5) - 1.0;
+	zipf->h_n = rejinv_hint(s, n + 0.5);
+	zipf->t = 2.0 - rejinv_hint_inv(s,
+		rejinv_hint(s, 2.5) - rejinv_h(s, 2.0));
+}
+
+long sample_zipf_rejinv(struct zipf_rejinv *zipf, struct unif_state *unif)
+{
+	double s = zipf->s;
+
+	while (1) {
+		double u = zipf->h_n + dsfmt_genrand_close_open(&unif->state) *
+			(zipf->h_x1 - zipf->h_n);
+		double x = rejinv_hint_inv(s, u);
+		long k = (long)(x + 0.5);
+
+		if (k < 1)
+			k = 1;
+		else if (k > zipf->n)
+			k = zipf->n;
+
+		/* The first test is a squeeze that avoids most
+		 * evaluations of H().
+		 */
+		if (k - x <= zipf->t ||
+			u >= rejinv_hint(s, k + 0.5) - rejinv_h(s, k))
+			return k;
+	}
+}
+
+#define ZIPF_AHEAD	8
+
+/* Fill @samples[0..(@n - 1)] with samples of @zipf drawn with @mt. */
+static void sample_zipf_range(struct zipf_state *zipf, dsfmt_t *mt,
+	long *samples, long n)
+{
+	/* Uniform numbers are drawn ZIPF_AHEAD samples ahead, so
+	 * their entries of the guide table can be prefetched.
+	 */
+	double ahead[ZIPF_AHEAD];
+	long i;
+
+	for (i = 0; i < ZIPF_AHEAD && i < n; i++)
+		ahead[i] = dsfmt_genrand_close_open(mt);
+	for (i = 0; i < n; i++) {
+		double z = ahead[i % ZIPF_AHEAD];
+		if (i + ZIPF_AHEAD < n) {
+			double next = dsfmt_genrand_close_open(mt);
+			ahead[i % ZIPF_AHEAD] = next;
+			__builtin_prefetch(&zipf->guide[
+				(long)(next * zipf->guide_size)]);
+		}
+		samples[i] = sample_zipf(zipf, z);
+	}
+}
+
+struct zipf_cache_job {
+	struct zipf_cache *cache;
+	struct zipf_state zipf;
+	uint32_t *seeds;
+	int len;
+};
+
+/* Each chunk of samples has its own stream of random numbers whose key
+ * is @seeds followed by the index of the chunk.
+ */
+static void sample_zipf_chunk(void *arg, long c)
+{
+	struct zipf_cache_job *job = arg;
+	struct zipf_cache *cache = job->cache;
+	long lo = c * ZIPF_CHUNK;
+	long hi = lo + ZIPF_CHUNK < cache->sample_size ?
+		lo + ZIPF_CHUNK : cache->sample_size;
+	uint32_t key[job->len + 1];
+	dsfmt_t mt;
+
+	memmove(key, job->seeds, job->len * sizeof(*key));
+	key[job->len] = c;
+	dsfmt_init_by_array(&mt, key, job->len + 1);
+	sample_zipf_range(&job->zipf, &mt, cache->samples + lo, hi - lo);
+}
+
+void init_zipf_cache(struct zipf_cache *cache, long sample_size,
+	double s, long n, uint32_t *seeds, int len, int parallel)
+{
+	struct zipf_cache_job job;
+
 	cache->s = s;
 	cache->n = n;
+	cache->parallel = parallel;
 
 	cache->index = 0;
 	cache->sample_size = sample_size;
 
 	cache->samples = malloc(sizeof(cache->samples[0]) * sample_size);
 	assert(cache->samples);
+	cache->map_len = 0;
+
+	init_zipf_state(&job.zipf, s, n, parallel);
+	if (parallel) {
+		job.cache = cache;
+		job.seeds = seeds;
+		job.len = len;
+		run_chunks(sample_zipf_chunk, &job, count_chunks(sample_size));
+	} else {
+		/* A single stream, as older versions. */
+		dsfmt_t mt;
+		dsfmt_init_by_array(&mt, seeds, len);
+		sample_zipf_range(&job.zipf, &mt, cache->samples,
+			sample_size);
+	}
+	end_zipf(&job.zipf);
+}
+
+/* Layout of files of init_zipf_cache_file(). */
+#define ZIPF_FILE_MAGIC		"ZIPFSMPL"
+#define ZIPF_FILE_VERSION	3
+#define ZIPF_FILE_MAX_SEEDS	32
 
-	dsfmt_init_by_array(&mt, seeds, len);
-	init_zipf(&zipf, s, n);
-	for (i = 0; i < sample_size; i++) {
-		double z = dsfmt_genrand_close_open(&mt);
-		cache->samples[i] = sample_zipf(&zipf, z);
+struct zipf_file_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t sample_bytes;	/* sizeof(long) of the writer. */
+	double s;
+	int64_t n;
+	int64_t sample_size;
+	int32_t seeds_len;
+	uint32_t seeds[ZIPF_FILE_MAX_SEEDS];
+	uint32_t parallel;	/* Samples of sampler 'pcache'. */
+};
+
+/* Samples start at this offset, so they are page aligned once mapped.
+ * It is the offset of shared-memory objects as well, so
+ * end_zipf_cache() unmaps both alike.
+ */
+#define ZIPF_FILE_DATA_OFFSET	SHMEM_DATA_OFFSET
+
+static void make_zipf_file_hdr(struct zipf_file_hdr *hdr, long sample_size,
+	double s, long n, uint32_t *seeds, int len, int parallel)
+{
+	assert(len <= ZIPF_FILE_MAX_SEEDS);
+	memset(hdr, 0, sizeof(*hdr));
+	memmove(hdr->magic, ZIPF_FILE_MAGIC, sizeof(hdr->magic));
+	hdr->version = ZIPF_FILE_VERSION;
+	hdr->sample_bytes = sizeof(long);
+	hdr->s = s;
+	hdr->n = n;
+	hdr->sample_size = sample_size;
+	hdr->seeds_len = len;
+	memmove(hdr->seeds, seeds, len * sizeof(*seeds));
+	hdr->parallel = parallel;
+}
+
+/* FNV-1a hash of @seeds; it only helps to name files. */
+static uint32_t hash_seeds(uint32_t *seeds, int len)
+{
+	const uint8_t *p = (const uint8_t *)seeds;
+	size_t i, bytes = len * sizeof(*seeds);
+	uint32_t h = 2166136261u;
+	for (i = 0; i < bytes; i++) {
+		h ^= p[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/* RETURN 1 if @filename was mapped into @cache, 0 otherwise. */
+static int map_zipf_file(struct zipf_cache *cache, const char *filename,
+	const struct zipf_file_hdr *expected)
+{
+	struct zipf_file_hdr hdr;
+	size_t map_len;
+	char *map;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		if (errno != ENOENT)
+			warn("Can't open file `%s'", filename);
+		return 0;
+	}
+
+	map_len = ZIPF_FILE_DATA_OFFSET +
+		expected->sample_size * sizeof(cache->samples[0]);
+	if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+		memcmp(&hdr, expected, sizeof(hdr)) ||
+		lseek(fd, 0, SEEK_END) != map_len) {
+		warnx("Ignoring file `%s' since it does not match", filename);
+		assert(!close(fd));
+		return 0;
+	}
+
+	map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+	assert(!close(fd));
+	if (map == MAP_FAILED) {
+		warn("Can't map file `%s'", filename);
+		return 0;
+	}
+
+	cache->samples = (long *)(map + ZIPF_FILE_DATA_OFFSET);
+	cache->map_len = map_len;
+	return 1;
+}
+
+/* RETURN 0 on success, or -1 and set errno on error. */
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	while (len > 0) {
+		ssize_t n = write(fd, p, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* Write to a temporary file, and rename it, so other processes
+ * never map a partial file.
+ *
+ * The file only saves time on later runs, so on errors, warn,
+ * remove the temporary file, and keep the samples in memory.
+ */
+static void write_zipf_file(struct zipf_cache *cache, const char *filename,
+	const struct zipf_file_hdr *hdr)
+{
+	char tmp[PATH_MAX], pad[ZIPF_FILE_DATA_OFFSET - sizeof(*hdr)];
+	int fd, failed;
+
+	assert(snprintf(tmp, sizeof(tmp), "%s.%i", filename, getpid()) <
+		sizeof(tmp));
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		warn("Can't create file `%s'", tmp);
+		return;
+	}
+
+	memset(pad, 0, sizeof(pad));
+	failed = write_all(fd, hdr, sizeof(*hdr)) ||
+		write_all(fd, pad, sizeof(pad)) ||
+		write_all(fd, cache->samples,
+			cache->sample_size * sizeof(cache->samples[0]));
+	if (close(fd))
+		failed = 1;
+	if (failed) {
+		warn("Can't write file `%s'", tmp);
+		unlink(tmp);
+		return;
+	}
+
+	if (rename(tmp, filename)) {
+		warn("Can't rename file `%s' to `%s'", tmp, filename);
+		unlink(tmp);
 	}
-	end_zipf(&zipf);
+}
+
+void init_zipf_cache_file(struct zipf_cache *cache, const char *dir,
+	long sample_size, double s, long n, uint32_t *seeds, int len,
+	int parallel)
+{
+	struct zipf_file_hdr hdr;
+	char filename[PATH_MAX];
+
+	make_zipf_file_hdr(&hdr, sample_size, s, n, seeds, len, parallel);
+	if (snprintf(filename, sizeof(filename),
+		"%s/zipf-v%i%s-s%g-n%li-k%li-%08x.bin", dir, ZIPF_FILE_VERSION,
+		parallel ? "p" : "", s, n, sample_size,
+		hash_seeds(seeds, len)) >= sizeof(filename))
+		errx(1, "Name of Zipf cache file in `%s' is too long", dir);
+
+	cache->s = s;
+	cache->n = n;
+	cache->parallel = parallel;
+	cache->index = 0;
+	cache->sample_size = sample_size;
+	if (map_zipf_file(cache, filename, &hdr))
+		return;
+
+	init_zipf_cache(cache, sample_size, s, n, seeds, len, parallel);
+	write_zipf_file(cache, filename, &hdr);
+}
+
+static int make_zipf_cache_key(uint64_t *key, long sample_size,
+	double s, long n, uint32_t *seeds, int len, int parallel)
+{
+	int key_len = 0;
+
+	assert((len + 1) / 2 + 4 <= SHMEM_KEY_LEN);
+	memmove(&key[key_len++], &s, sizeof(s));
+	key[key_len++] = n;
+	key[key_len++] = sample_size;
+	key[key_len++] = parallel;
+	return key_len + seeds_to_shmem_key(key + key_len, seeds, len);
+}
+
+void publish_zipf_cache(struct zipf_cache *cache, const char *name,
+	uint32_t *seeds, int len)
+{
+	uint64_t key[SHMEM_KEY_LEN];
+	int key_len = make_zipf_cache_key(key, cache->sample_size, cache->s,
+		cache->n, seeds, len, cache->parallel);
+	publish_shmem(name, key, key_len, cache->samples,
+		sizeof(cache->samples[0]), cache->sample_size);
+}
+
+void init_zipf_cache_shmem(struct zipf_cache *cache, const char *name,
+	long sample_size, double s, long n, uint32_t *seeds, int len,
+	int parallel)
+{
+	uint64_t key[SHMEM_KEY_LEN];
+	int key_len = make_zipf_cache_key(key, sample_size, s, n, seeds, len,
+		parallel);
+	uint64_t count;
+
+	cache->s = s;
+	cache->n = n;
+	cache->parallel = parallel;
+	cache->index = 0;
+	cache->sample_size = sample_size;
+	cache->samples = (long *)attach_shmem(name, key, key_len,
+		sizeof(cache->samples[0]), &count, &cache->map_len);
+	assert(count == sample_size);
 }
 
 void end_zipf_cache(struct zipf_cache *cache)
 {
 	void *p = cache->samples;
 	cache->samples = NULL;
+	if (cache->map_len) {
+		assert(!munmap((char *)p - ZIPF_FILE_DATA_OFFSET,
+			cache->map_len));
+		cache->map_len = 0;
+		return;
+	}
 	free(p);
 }
 
+void slice_zipf_cache(struct zipf_cache *slice, struct zipf_cache *cache,
+	int i, int n)
+{
+	long first, last;
+
+	assert(n >= 1);
+	assert(0 <= i && i < n);
+	assert(cache->sample_size >= n);
+
+	first = cache->sample_size * i / n;
+	last = cache->sample_size * (i + 1) / n;
+
+	slice->s = cache->s;
+	slice->n = cache->n;
+	slice->parallel = cache->parallel;
+	slice->index = 0;
+	slice->sample_size = last - first;
+	slice->samples = cache->samples + first;
+	slice->map_len = 0;
+}
+
 long sample_zipf_cache(struct zipf_cache *cache)
 {
 	long i = cache->index;
@@ -32,6 +32,9 @@ static struct argp_option options[] = {
 	{"prefix",	'p', "FILE",	0, "Name of prefix file"},
 	{"prefix-limit", 'x', "N",	0,
 		"Consider only the first N entries of the prefix file *after* shuffling it"},
+	{"synthetic",	'N', "N",	0,
+		"Generate N random prefixes from the seeds of the run "
+		"instead of loading the prefix file"},
 	{"stack",	's', "NET",	0,
 		"Chose between 'ip' and 'xia' stacks"},
 	{"load-update",	'l', 0,		0, "Assume updating instead of "
@@ -44,6 +47,7 @@ static struct argp_option options[] = {
 struct args {
 	const char *prefix_filename;
 	uint64_t prefix_limit;
+	uint64_t synthetic;
 	const char *stack;
 	int load_update;
 	int update_rate;	/* updates per seconds */
@@ -119,6 +123,12 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 			argp_error(state, "Prefix limit must be >= 1");
 		break;
 
+	case 'N':
+		args->synthetic = arg_to_long(state, arg);
+		if (args->synthetic < 1)
+			argp_error(state, "Number of prefixes must be >= 1");
+		break;
+
 	case 's':
 		args->stack = arg;
 		if (strcmp(arg, "ip") && strcmp(arg, "xia"))
@@ -196,6 +206,9 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 		if (args->update_rate > 0 && args->count == 1)
 			argp_error(state, "When update rate (= %i) is greater than zero, there must be at least two pairs of interface and gateway",
 				args->update_rate);
+		if (args->synthetic && args->prefix_limit)
+			argp_error(state, "Options --synthetic and "
+				"--prefix-limit are mutually exclusive");
 		break;
 
 	default:
@@ -212,6 +225,7 @@ int main(int argc, char **argv)
 		/* Defaults. */
 		.prefix_filename	= "prefix",
 		.prefix_limit		= 0,
+		.synthetic		= 0,
 		.stack			= "ip",
 		.load_update		= 0,
 		.update_rate		= 0,
@@ -225,8 +239,8 @@ int main(int argc, char **argv)
 
 	int nnodes, node_id;
 	struct seed s1, s2, node_seed;
-	int force_addr;
-	struct net_prefix *prefixes;
+	int force_addr, stack;
+	struct prefix_table table;
 	uint64_t prefixes_count, i;
 	struct unif_state port_dist, prefix_dist;
 	struct rtnl_batch b;
@@ -242,34 +256,45 @@ int main(int argc, char **argv)
 	node_id = nnodes;		/* It is the router.	*/
 	load_seeds(args.run, nnodes, node_id, &s1, &s2, &node_seed);
 
-	/* Load and shuffle destination addresses. */
+	/* Load and shuffle destination addresses, and keep only
+	 * the compact prefixes of the stack; the prefix file is streamed,
+	 * so it need not fit in memory.
+	 */
 	force_addr = !!strcmp(args.stack, "ip"); /* Only IP uses CIDR. */
-	prefixes = load_file_as_shuffled_addrs(args.prefix_filename,
-		&prefixes_count, s1.seeds, SEED_UINT32_N, force_addr);
+	stack = force_addr ? PREFIX_TABLE_XIA : PREFIX_TABLE_IP;
+	if (args.synthetic) {
+		struct net_prefix *prefixes = generate_prefixes(
+			args.synthetic, stack, s1.seeds, SEED_UINT32_N,
+			force_addr);
+		init_prefix_table(&table, stack, prefixes, args.synthetic);
+		free_net_prefix(prefixes);
+		prefixes_count = args.synthetic;
+	} else {
+		prefixes_count = load_prefix_table(&table, stack,
+			args.prefix_filename, args.prefix_limit,
+			s1.seeds, SEED_UINT32_N, force_addr);
+	}
 	if (!prefixes_count)
 		err(1, "Prefix file `%s' is empty", args.prefix_filename);
-	if (args.prefix_limit) {
-		if (args.prefix_limit > prefixes_count)
-			err(1, "Option --prefix-limit=%" PRIu64 " "
-				"is larger than the number of entries in "
-				"the prefix file `%s' (= %" PRIu64 ")",
-				args.prefix_limit, args.prefix_filename,
-				prefixes_count);
-		prefixes_count = args.prefix_limit;
-	}
+	if (args.prefix_limit > prefixes_count)
+		err(1, "Option --prefix-limit=%" PRIu64 " "
+			"is larger than the number of entries in "
+			"the prefix file `%s' (= %" PRIu64 ")",
+			args.prefix_limit, args.prefix_filename,
+			prefixes_count);
+	prefixes_count = table.n;
 
 	/* Initialize port numbers. */
 	init_unif(&port_dist, s2.seeds, SEED_UINT32_N);
-	assign_port(prefixes, prefixes_count, args.count, &port_dist);
+	assign_port(&table, args.count, &port_dist);
 
 	/* Load destinations into routing table. */
 	init_rtnl_batch(&b, args.stack);
 	printf_fsh("Loading routing table... ");
 	start = now();
 	for (i = 0; i < prefixes_count; i++) {
-		struct net_prefix *pp = &prefixes[i];
-		struct port *pt = &args.ports[pp->port];
-		rtnl_add_route_to_batch(&b, pp, pt, args.load_update);
+		struct port *pt = &args.ports[prefix_table_port(&table, i)];
+		rtnl_add_route_to_batch(&b, &table, i, pt, args.load_update);
 	}
 	flush_rtnl_batch(&b);
 	diff = now() - start;
@@ -294,28 +319,28 @@ int main(int argc, char **argv)
 		/* Sample destination. */
 		uint64_t prefix_sample = sample_unif_0_n1(&prefix_dist,
 			prefixes_count);
-		struct net_prefix *pp = &prefixes[prefix_sample];
+		int old_port = prefix_table_port(&table, prefix_sample);
 
  		/* Sample new gateway. */
 		int port_sample;
 		struct port *new_port;
-		if (pp->port != last) {
-			struct port *temp = ports[pp->port];
-			ports[pp->port] = ports[last];
+		if (old_port != last) {
+			struct port *temp = ports[old_port];
+			ports[old_port] = ports[last];
 			ports[last] = temp;
 		}
 		port_sample = sample_unif_0_n1(&port_dist, last);
 		new_port = ports[port_sample];
-		if (pp->port != last) {
-			struct port *temp = ports[pp->port];
-			ports[pp->port] = ports[last];
+		if (old_port != last) {
+			struct port *temp = ports[old_port];
+			ports[old_port] = ports[last];
 			ports[last] = temp;
 		}
-		assert(pp->port != new_port->index);
-		pp->port = new_port->index;
+		assert(old_port != new_port->index);
+		set_prefix_table_port(&table, prefix_sample, new_port->index);
 
 		/* Update routing table. */
-		rtnl_add_route_to_batch(&b, pp, new_port, 1);
+		rtnl_add_route_to_batch(&b, &table, prefix_sample, new_port, 1);
 
 		count++;
 		upd_to_sleep--;
@@ -348,7 +373,7 @@ int main(int argc, char **argv)
 out:
 	end_rtnl_batch(&b);
 	end_unif(&port_dist);
-	free_net_prefix(prefixes);
+	end_prefix_table(&table);
 	end_args(&args);
 	return 0;
 }
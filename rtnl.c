@@ -161,11 +161,12 @@ int flush_rtnl_batch(struct rtnl_batch *b)
 }
 
 static void add_ipv4_route_to_batch(struct rtnl_batch *b,
-	const struct net_prefix *prefix, const struct port *port, int update)
+	struct prefix_table *table, uint64_t i, const struct port *port,
+	int update)
 {
 	put_ipv4_rtable_add(mnl_nlmsg_batch_current(b->batch), b->seq++,
-		prefix->addr.ip, prefix->mask, port->iface, port->gateway.ip,
-		update);
+		prefix_table_addr(table, i)->ip, prefix_table_mask(table, i),
+		port->iface, port->gateway.ip, update);
 
 	/* Is there room for more messages in this batch? */
 	if (!mnl_nlmsg_batch_next(b->batch))
@@ -173,10 +174,11 @@ static void add_ipv4_route_to_batch(struct rtnl_batch *b,
 }
 
 static void add_xip_route_to_batch(struct rtnl_batch *b,
-	const struct net_prefix *prefix, const struct port *port, int update)
+	struct prefix_table *table, uint64_t i, const struct port *port,
+	int update)
 {
 	put_xip_rtable_add(mnl_nlmsg_batch_current(b->batch), b->seq++,
-		&prefix->addr, &port->gateway, update);
+		prefix_table_addr(table, i), &port->gateway, update);
 
 	/* Is there room for more messages in this batch? */
 	if (!mnl_nlmsg_batch_next(b->batch))
@@ -61,6 +61,25 @@ void load_seeds(int run, int nnodes, int node_id,
 	close_seeds(seeds);
 }
 
+/* Finalizer of MurmurHash3; it is a bijection on 32 bits. */
+static inline uint32_t mix32(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+void derive_seed(const struct seed *s, uint32_t tag, struct seed *derived)
+{
+	int i;
+	for (i = 0; i < SEED_UINT32_N; i++)
+		derived->seeds[i] = mix32(s->seeds[i] ^
+			mix32(tag * SEED_UINT32_N + i + 1));
+}
+
 void print_seed(const char *name, struct seed *s)
 {
 	int i;
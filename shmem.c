@@ -0,0 +1,129 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <shmem.h>
+
+#define SHMEM_MAGIC	"NETEVSHM"
+#define SHMEM_VERSION	1
+
+struct shmem_hdr {
+	char magic[8];		/* Written last; see publish_shmem(). */
+	uint32_t version;
+	uint32_t elem_size;
+	uint64_t count;
+	uint64_t key[SHMEM_KEY_LEN];
+};
+
+static void make_shmem_hdr(struct shmem_hdr *hdr, const uint64_t *key,
+	int key_len, uint32_t elem_size, uint64_t count)
+{
+	assert(key_len >= 0 && key_len <= SHMEM_KEY_LEN);
+	assert(sizeof(*hdr) <= SHMEM_DATA_OFFSET);
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->version = SHMEM_VERSION;
+	hdr->elem_size = elem_size;
+	hdr->count = count;
+	memmove(hdr->key, key, key_len * sizeof(*key));
+}
+
+void publish_shmem(const char *name, const uint64_t *key, int key_len,
+	const void *data, uint32_t elem_size, uint64_t count)
+{
+	size_t map_len = SHMEM_DATA_OFFSET + count * elem_size;
+	struct shmem_hdr *hdr;
+	char *map;
+	int fd;
+
+	if (shm_unlink(name) && errno != ENOENT)
+		err(1, "Can't remove shared memory object `%s'", name);
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+		err(1, "Can't create shared memory object `%s'", name);
+	if (ftruncate(fd, map_len))
+		err(1, "Can't resize shared memory object `%s'", name);
+	map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		err(1, "Can't map shared memory object `%s'", name);
+	assert(!close(fd));
+
+	hdr = (struct shmem_hdr *)map;
+	make_shmem_hdr(hdr, key, key_len, elem_size, count);
+	memmove(map + SHMEM_DATA_OFFSET, data, count * elem_size);
+
+	/* Processes that attach before the magic is in place
+	 * find an incomplete object, and refuse it.
+	 */
+	__sync_synchronize();
+	memmove(hdr->magic, SHMEM_MAGIC, sizeof(hdr->magic));
+	assert(!munmap(map, map_len));
+}
+
+const void *attach_shmem(const char *name, const uint64_t *key, int key_len,
+	uint32_t elem_size, uint64_t *pcount, size_t *pmap_len)
+{
+	struct shmem_hdr expected;
+	const struct shmem_hdr *hdr;
+	struct stat st;
+	size_t map_len;
+	char *map;
+	int fd;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		err(1, "Can't open shared memory object `%s'", name);
+	if (fstat(fd, &st))
+		err(1, "Can't find size of shared memory object `%s'", name);
+	map_len = st.st_size;
+	if (map_len < SHMEM_DATA_OFFSET)
+		errx(1, "Shared memory object `%s' is too short", name);
+	map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		err(1, "Can't map shared memory object `%s'", name);
+	assert(!close(fd));
+
+	hdr = (const struct shmem_hdr *)map;
+	if (memcmp(hdr->magic, SHMEM_MAGIC, sizeof(hdr->magic)))
+		errx(1, "Shared memory object `%s' is incomplete", name);
+	__sync_synchronize();
+	make_shmem_hdr(&expected, key, key_len, elem_size, hdr->count);
+	memmove(expected.magic, SHMEM_MAGIC, sizeof(expected.magic));
+	if (memcmp(hdr, &expected, sizeof(expected)) ||
+		map_len != SHMEM_DATA_OFFSET + hdr->count * elem_size)
+		errx(1, "Shared memory object `%s' does not match "
+			"the parameters of this run", name);
+
+	*pcount = hdr->count;
+	*pmap_len = map_len;
+	return map + SHMEM_DATA_OFFSET;
+}
+
+void detach_shmem(const void *data, size_t map_len)
+{
+	assert(!munmap((char *)data - SHMEM_DATA_OFFSET, map_len));
+}
+
+int seeds_to_shmem_key(uint64_t *key, const uint32_t *seeds, int len)
+{
+	int i, words = (len + 1) / 2;
+
+	memset(key, 0, words * sizeof(*key));
+	for (i = 0; i < len; i++)
+		key[i / 2] |= (uint64_t)seeds[i] << (32 * (i % 2));
+	return words;
+}
+
+int unlink_shmem(const char *name)
+{
+	if (!shm_unlink(name))
+		return 0;
+	if (errno != ENOENT)
+		err(1, "Can't remove shared memory object `%s'", name);
+	return -1;
+}
@@ -0,0 +1,286 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+
+#include <sketch.h>
+
+void init_hll(struct hll *hll)
+{
+	memset(hll->regs, 0, sizeof(hll->regs));
+}
+
+double hll_count(struct hll *hll)
+{
+	const int m = 1 << HLL_BITS;
+	double sum = 0.0, estimate;
+	int i, zeros = 0;
+
+	for (i = 0; i < m; i++) {
+		sum += ldexp(1.0, -hll->regs[i]);
+		if (!hll->regs[i])
+			zeros++;
+	}
+	estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+
+	/* Small cardinalities are better estimated by linear counting.
+	 * Large ones need no correction with 64-bit hashes.
+	 */
+	if (estimate <= 2.5 * m && zeros)
+		estimate = m * log((double)m / zeros);
+	return estimate;
+}
+
+void init_space_saving(struct space_saving *ss, long m)
+{
+	long i, size = 1;
+
+	assert(m >= 1 && m < UINT32_MAX);
+	while (size < 2 * m)
+		size <<= 1;
+
+	ss->m = m;
+	ss->counters = calloc(m, sizeof(*ss->counters));
+	assert(ss->counters);
+	ss->table = calloc(size, sizeof(*ss->table));
+	assert(ss->table);
+	ss->table_mask = size - 1;
+	ss->group_end = malloc(sizeof(*ss->group_end) * m);
+	assert(ss->group_end);
+	ss->free_groups = malloc(sizeof(*ss->free_groups) * m);
+	assert(ss->free_groups);
+
+	/* All unused counters form group 0. */
+	ss->group_end[0] = m - 1;
+	ss->nfree = 0;
+	for (i = m - 1; i >= 1; i--)
+		ss->free_groups[ss->nfree++] = i;
+}
+
+void end_space_saving(struct space_saving *ss)
+{
+	free(ss->free_groups);
+	free(ss->group_end);
+	free(ss->table);
+	free(ss->counters);
+	ss->free_groups = NULL;
+	ss->group_end = NULL;
+	ss->table = NULL;
+	ss->counters = NULL;
+}
+
+/* Linear probing; return the slot of @dst, or the empty slot
+ * where it would go.
+ */
+static long ss_find(struct space_saving *ss, uint64_t dst, uint64_t hash)
+{
+	long slot = hash & ss->table_mask;
+
+	while (ss->table[slot] &&
+		ss->counters[ss->table[slot] - 1].dst != dst)
+		slot = (slot + 1) & ss->table_mask;
+	return slot;
+}
+
+static inline void ss_set_slot(struct space_saving *ss, long slot,
+	uint32_t index)
+{
+	ss->table[slot] = index + 1;
+	ss->counters[index].slot = slot;
+}
+
+/* Remove @slot keeping the probe sequences of the other entries intact. */
+static void ss_remove(struct space_saving *ss, long slot)
+{
+	long i = slot, j = slot;
+
+	ss->table[i] = 0;
+	while (1) {
+		long home;
+
+		j = (j + 1) & ss->table_mask;
+		if (!ss->table[j])
+			break;
+		home = hash_dst(ss->counters[ss->table[j] - 1].dst) &
+			ss->table_mask;
+		/* Move the entry at @j to the hole at @i unless
+		 * its home is cyclically within (i, j].
+		 */
+		if (i <= j ? (home <= i || home > j) :
+			(home <= i && home > j)) {
+			ss_set_slot(ss, i, ss->table[j] - 1);
+			ss->table[j] = 0;
+			i = j;
+		}
+	}
+}
+
+static void ss_swap(struct space_saving *ss, long a, long b)
+{
+	struct ss_counter tmp = ss->counters[a];
+	/* Unused counters are not in the table. */
+	int in_a = ss->table[ss->counters[a].slot] == a + 1;
+	int in_b = ss->table[ss->counters[b].slot] == b + 1;
+
+	ss->counters[a] = ss->counters[b];
+	ss->counters[b] = tmp;
+	if (in_b)
+		ss->table[ss->counters[a].slot] = a + 1;
+	if (in_a)
+		ss->table[ss->counters[b].slot] = b + 1;
+}
+
+static void ss_increment(struct space_saving *ss, long i)
+{
+	struct ss_counter *c = ss->counters;
+	uint32_t group = c[i].group;
+	long end = ss->group_end[group];
+
+	/* Move the counter to the end of its group, and out of it. */
+	ss_swap(ss, i, end);
+	if (end == 0 || c[end - 1].group != group)
+		ss->free_groups[ss->nfree++] = group;
+	else
+		ss->group_end[group] = end - 1;
+
+	/* Join the next group, or start a new one. */
+	c[end].count++;
+	if (end + 1 < ss->m && c[end + 1].count == c[end].count) {
+		c[end].group = c[end + 1].group;
+	} else {
+		assert(ss->nfree > 0);
+		c[end].group = ss->free_groups[--ss->nfree];
+		ss->group_end[c[end].group] = end;
+	}
+}
+
+void space_saving_add(struct space_saving *ss, uint64_t dst, uint64_t hash)
+{
+	long slot = ss_find(ss, dst, hash);
+	struct ss_counter *min = &ss->counters[0];
+
+	if (ss->table[slot]) {
+		ss_increment(ss, ss->table[slot] - 1);
+		return;
+	}
+
+	/* Replace the least frequent destination, or take an unused
+	 * counter, which is always the least frequent one.
+	 */
+	if (min->count) {
+		ss_remove(ss, min->slot);
+		slot = ss_find(ss, dst, hash);
+	}
+	min->dst = dst;
+	min->error = min->count;
+	ss_set_slot(ss, slot, 0);
+	ss_increment(ss, 0);
+}
+
+void init_lru_sim(struct lru_sim *sim, long size, long sim_size)
+{
+	long buckets = 1;
+
+	assert(size >= 1);
+	assert(sim_size >= 1 && sim_size < UINT32_MAX);
+	if (sim_size > size)
+		sim_size = size;
+	while (buckets < 2 * sim_size)
+		buckets <<= 1;
+
+	sim->size = size;
+	sim->sim_size = sim_size;
+	sim->threshold = sim_size == size ? UINT64_MAX :
+		(uint64_t)ldexp((double)sim_size / size, 64);
+	sim->refs = 0;
+	sim->hits = 0;
+	sim->dst = malloc(sizeof(*sim->dst) * sim_size);
+	sim->next = malloc(sizeof(*sim->next) * sim_size);
+	sim->prev = malloc(sizeof(*sim->prev) * sim_size);
+	sim->chain = malloc(sizeof(*sim->chain) * sim_size);
+	sim->buckets = calloc(buckets, sizeof(*sim->buckets));
+	assert(sim->dst && sim->next && sim->prev && sim->chain &&
+		sim->buckets);
+	sim->bucket_mask = buckets - 1;
+	sim->used = 0;
+	sim->head = 0;
+}
+
+void end_lru_sim(struct lru_sim *sim)
+{
+	free(sim->buckets);
+	free(sim->chain);
+	free(sim->prev);
+	free(sim->next);
+	free(sim->dst);
+	sim->buckets = sim->chain = sim->prev = sim->next = NULL;
+	sim->dst = NULL;
+}
+
+/* Hash chains hold entries + 1, so zero ends them. */
+static void lru_sim_unchain(struct lru_sim *sim, uint32_t e)
+{
+	uint32_t *p = &sim->buckets[hash_dst(sim->dst[e]) & sim->bucket_mask];
+
+	while (*p != e + 1)
+		p = &sim->chain[*p - 1];
+	*p = sim->chain[e];
+}
+
+void lru_sim_add(struct lru_sim *sim, uint64_t dst, uint64_t hash)
+{
+	uint32_t *bucket, e, i;
+
+	/* Sampling takes the high bits of @hash, and the buckets the low
+	 * ones, so the sampled destinations spread over all buckets.
+	 */
+	if (hash > sim->threshold)
+		return;
+	sim->refs++;
+
+	bucket = &sim->buckets[hash & sim->bucket_mask];
+	for (i = *bucket; i; i = sim->chain[i - 1])
+		if (sim->dst[i - 1] == dst)
+			break;
+
+	if (i) {
+		sim->hits++;
+		e = i - 1;
+		if (e == sim->head)
+			return;
+		if (e != sim->prev[sim->head]) {
+			/* Unlink @e, and insert it before the head. */
+			sim->next[sim->prev[e]] = sim->next[e];
+			sim->prev[sim->next[e]] = sim->prev[e];
+			sim->next[e] = sim->head;
+			sim->prev[e] = sim->prev[sim->head];
+			sim->next[sim->prev[e]] = e;
+			sim->prev[sim->head] = e;
+		}
+		/* The list is circular, so the tail
+		 * becomes the head by rotation.
+		 */
+		sim->head = e;
+		return;
+	}
+
+	if (sim->used < sim->sim_size) {
+		e = sim->used++;
+		if (!e) {
+			sim->next[e] = sim->prev[e] = e;
+		} else {
+			sim->next[e] = sim->head;
+			sim->prev[e] = sim->prev[sim->head];
+			sim->next[sim->prev[e]] = e;
+			sim->prev[sim->head] = e;
+		}
+	} else {
+		/* Evict the tail. */
+		e = sim->prev[sim->head];
+		lru_sim_unchain(sim, e);
+	}
+	sim->dst[e] = dst;
+	sim->chain[e] = *bucket;
+	*bucket = e + 1;
+	sim->head = e;
+}
@@ -1,5 +1,7 @@
 /* Send an IPv4 packet via raw socket. */
 
+#define _GNU_SOURCE		/* sendmmsg()		*/
+
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
@@ -8,12 +10,16 @@
 
 #include <sys/types.h>		/* socket(), sendto()	*/
 #include <sys/socket.h>		/* socket(), sendto()	*/
-#include <unistd.h>		/* close()		*/
+#include <sys/uio.h>		/* struct iovec		*/
+#include <sys/ioctl.h>		/* ioctl()		*/
+#include <sys/mman.h>		/* mmap(), munmap()	*/
+#include <unistd.h>		/* close(), sysconf()	*/
 #include <arpa/inet.h>		/* inet_pton(), htons()	*/
 #include <net/if.h>		/* if_nametoindex()	*/
 #include <netinet/ip.h>		/* struct iphdr, IP_MAXPACKET (== 65535) */
 #include <linux/if_ether.h>	/* ETH_P_IP		*/
-#include <netpacket/packet.h>	/* See packet(7)	*/
+#include <linux/if_packet.h>	/* See packet(7)	*/
+#include <linux/if_xdp.h>	/* AF_XDP sockets	*/
 #include <net/ethernet.h>	/* The L2 protocols	*/
 
 #include <net/xia.h>
@@ -234,55 +240,501 @@ static void set_dev(struct sockaddr_ll *dev, const char *ifname, int proto,
 	memmove(dev->sll_addr, dst_mac, len);
 }
 
-static inline int engine_send(struct sndpkt_engine *engine)
+/* Return true if the failure of a send call only means that
+ * the kernel is out of buffers for now.
+ */
+static int transient_send_error(int error)
 {
-	ssize_t sent = sendto(engine->sk, engine->pkt_template,
-		engine->template_len, MSG_DONTWAIT,
-		(struct sockaddr *)&engine->dev, sizeof(engine->dev));
-	if (sent == engine->template_len)
-		return 1;
-
-	assert(sent == -1);
-	switch (errno) {
+	switch (error) {
 	case ENOBUFS:
 	case EAGAIN:
 #if EAGAIN != EWOULDBLOCK
 	case EWOULDBLOCK:
 #endif
-		break;
+		return 1;
 
 	default:
-		warn("sendto() failed with %li", sent);
-		break;
+		return 0;
 	}
+}
+
+static void open_packet_socket(struct sndpkt_engine *engine)
+{
+	engine->sk = socket(AF_PACKET, SOCK_DGRAM, 0);
+	if (engine->sk < 0)
+		err(EXIT_FAILURE, "socket() failed");
+
+	/* Put only @ifname in promiscuous mode. */
+	assert(!bind(engine->sk, (const struct sockaddr *)&engine->dev,
+		sizeof(engine->dev)));
+}
+
+static int socket_send_packet(struct sndpkt_engine *engine,
+	union net_addr *addr)
+{
+	ssize_t sent;
+
+	engine->set_dst(engine, engine->pkt_template, addr);
+	sent = sendto(engine->sk, engine->pkt_template,
+		engine->template_len, MSG_DONTWAIT,
+		(struct sockaddr *)&engine->dev, sizeof(engine->dev));
+	if (sent == engine->template_len)
+		return 1;
+
+	assert(sent == -1);
+	if (!transient_send_error(errno))
+		warn("sendto() failed with %li", sent);
+	return 0;
+}
+
+static int socket_send_batch(struct sndpkt_engine *engine,
+	union net_addr **addrs, int n)
+{
+	struct sndpkt_batch *batch = &engine->batch;
+	int i, sent;
+
+	assert(n >= 1 && n <= SNDPKT_MAX_BATCH);
+	for (i = 0; i < n; i++)
+		engine->set_dst(engine, batch->iov[i].iov_base, addrs[i]);
+
+	sent = sendmmsg(engine->sk, batch->msgs, n, MSG_DONTWAIT);
+	if (sent >= 0)
+		return sent;
+
+	if (!transient_send_error(errno))
+		warn("sendmmsg() failed with %i", sent);
 	return 0;
 }
 
-static int ipv4_send_packet(struct sndpkt_engine *engine, union net_addr *addr)
+static void socket_flush(struct sndpkt_engine *engine)
 {
-	set_ipv4_template(engine->pkt_template, addr->ip,
-		engine->cookie.ip.sum);
-	return engine_send(engine);
+	/* Empty. */
 }
 
-static int xia_send_packet(struct sndpkt_engine *engine, union net_addr *addr)
+static void init_socket(struct sndpkt_engine *engine)
 {
-	set_xia_template(engine->pkt_template, engine->cookie.xia.offset, addr);
-	return engine_send(engine);
+	struct sndpkt_batch *batch = &engine->batch;
+	int i;
+
+	open_packet_socket(engine);
+
+	batch->pkts = malloc(SNDPKT_MAX_BATCH * engine->template_len);
+	batch->iov = malloc(SNDPKT_MAX_BATCH * sizeof(*batch->iov));
+	batch->msgs = malloc(SNDPKT_MAX_BATCH * sizeof(*batch->msgs));
+	assert(batch->pkts && batch->iov && batch->msgs);
+	memset(batch->msgs, 0, SNDPKT_MAX_BATCH * sizeof(*batch->msgs));
+
+	for (i = 0; i < SNDPKT_MAX_BATCH; i++) {
+		struct msghdr *hdr = &batch->msgs[i].msg_hdr;
+		char *pkt = batch->pkts + i * engine->template_len;
+
+		memmove(pkt, engine->pkt_template, engine->template_len);
+		batch->iov[i].iov_base = pkt;
+		batch->iov[i].iov_len = engine->template_len;
+
+		hdr->msg_name = &engine->dev;
+		hdr->msg_namelen = sizeof(engine->dev);
+		hdr->msg_iov = &batch->iov[i];
+		hdr->msg_iovlen = 1;
+	}
+
+	engine->send_packet = socket_send_packet;
+	engine->send_batch = socket_send_batch;
+	engine->flush = socket_flush;
+}
+
+static void end_socket(struct sndpkt_engine *engine)
+{
+	struct sndpkt_batch *batch = &engine->batch;
+	free(batch->msgs);
+	free(batch->iov);
+	free(batch->pkts);
+	batch->pkts = NULL;
+}
+
+/* Number of frames in the TX ring. */
+#define RING_FRAMES		4096
+
+/* Number of frames queued before the kernel is kicked. */
+#define RING_BATCH		64
+
+/* Without PACKET_TX_HAS_OFF, the kernel expects the packet of SOCK_DGRAM
+ * sockets right after the TPACKET_V2 header.
+ */
+#define RING_DATA_OFFSET	(TPACKET2_HDRLEN - sizeof(struct sockaddr_ll))
+
+static inline struct tpacket2_hdr *ring_frame(struct sndpkt_ring *ring,
+	unsigned int i)
+{
+	return (struct tpacket2_hdr *)(ring->map +
+		(i / ring->frames_per_block) * ring->block_size +
+		(i % ring->frames_per_block) * ring->frame_size);
+}
+
+static void ring_flush(struct sndpkt_engine *engine)
+{
+	struct sndpkt_ring *ring = &engine->ring;
+	ssize_t sent;
+
+	if (!ring->pending)
+		return;
+
+	/* The kernel sends all frames marked with TP_STATUS_SEND_REQUEST.
+	 * If it fails, the frames keep their status, so @pending is
+	 * preserved to kick the kernel again later.
+	 */
+	sent = sendto(engine->sk, NULL, 0, MSG_DONTWAIT,
+		(struct sockaddr *)&engine->dev, sizeof(engine->dev));
+	if (sent >= 0) {
+		ring->pending = 0;
+		return;
+	}
+	if (!transient_send_error(errno))
+		warn("sendto() failed to kick TX ring");
+}
+
+/* RETURN 1 if the packet was queued, 0 if the ring is full. */
+static int ring_queue_packet(struct sndpkt_engine *engine,
+	union net_addr *addr)
+{
+	struct sndpkt_ring *ring = &engine->ring;
+	struct tpacket2_hdr *hdr = ring_frame(ring, ring->head);
+	uint32_t status = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+
+	if (status != TP_STATUS_AVAILABLE) {
+		if (status & TP_STATUS_WRONG_FORMAT)
+			errx(1, "Kernel refused a frame of the TX ring");
+		return 0;
+	}
+
+	/* The frame already holds a copy of the template. */
+	engine->set_dst(engine, (char *)hdr + RING_DATA_OFFSET, addr);
+	hdr->tp_len = engine->template_len;
+	__atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST,
+		__ATOMIC_RELEASE);
+
+	if (++ring->head == ring->frame_nr)
+		ring->head = 0;
+	ring->pending++;
+	return 1;
+}
+
+static int ring_send_packet(struct sndpkt_engine *engine,
+	union net_addr *addr)
+{
+	if (!ring_queue_packet(engine, addr)) {
+		/* The ring is full. */
+		ring_flush(engine);
+		return 0;
+	}
+	if (engine->ring.pending >= RING_BATCH)
+		ring_flush(engine);
+	return 1;
+}
+
+static int ring_send_batch(struct sndpkt_engine *engine,
+	union net_addr **addrs, int n)
+{
+	int i;
+
+	assert(n >= 1 && n <= SNDPKT_MAX_BATCH);
+	for (i = 0; i < n; i++)
+		if (!ring_queue_packet(engine, addrs[i]))
+			break;
+	ring_flush(engine);
+	return i;
+}
+
+static void init_ring(struct sndpkt_engine *engine)
+{
+	struct sndpkt_ring *ring = &engine->ring;
+	struct tpacket_req req;
+	int version = TPACKET_V2;
+	unsigned int i;
+
+	open_packet_socket(engine);
+	assert(!setsockopt(engine->sk, SOL_PACKET, PACKET_VERSION,
+		&version, sizeof(version)));
+
+	ring->frame_size = TPACKET_ALIGN(RING_DATA_OFFSET +
+		engine->template_len);
+	ring->block_size = sysconf(_SC_PAGESIZE);
+	while (ring->block_size < ring->frame_size)
+		ring->block_size <<= 1;
+	ring->frames_per_block = ring->block_size / ring->frame_size;
+	ring->frame_nr = RING_FRAMES - RING_FRAMES % ring->frames_per_block;
+	if (!ring->frame_nr)
+		ring->frame_nr = ring->frames_per_block;
+	ring->head = 0;
+	ring->pending = 0;
+
+	req.tp_block_size = ring->block_size;
+	req.tp_block_nr = ring->frame_nr / ring->frames_per_block;
+	req.tp_frame_size = ring->frame_size;
+	req.tp_frame_nr = ring->frame_nr;
+	if (setsockopt(engine->sk, SOL_PACKET, PACKET_TX_RING,
+		&req, sizeof(req)))
+		err(1, "setsockopt(PACKET_TX_RING) failed");
+
+	ring->map_len = (size_t)req.tp_block_size * req.tp_block_nr;
+	ring->map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE,
+		MAP_SHARED, engine->sk, 0);
+	if (ring->map == MAP_FAILED)
+		err(1, "mmap() of TX ring failed");
+
+	/* Leave per-packet work down to writing the destination. */
+	for (i = 0; i < ring->frame_nr; i++)
+		memmove((char *)ring_frame(ring, i) + RING_DATA_OFFSET,
+			engine->pkt_template, engine->template_len);
+
+	engine->send_packet = ring_send_packet;
+	engine->send_batch = ring_send_batch;
+	engine->flush = ring_flush;
+}
+
+static void end_ring(struct sndpkt_engine *engine)
+{
+	struct sndpkt_ring *ring = &engine->ring;
+	ring_flush(engine);
+	assert(!munmap(ring->map, ring->map_len));
+	ring->map = NULL;
+}
+
+/* Number of frames in the UMEM; it must be a power of 2. */
+#define XDP_FRAMES		4096
+
+static void xdp_flush(struct sndpkt_engine *engine)
+{
+	struct sndpkt_xdp *xdp = &engine->xdp;
+
+	if (!(__atomic_load_n(xdp->tx.flags, __ATOMIC_RELAXED) &
+		XDP_RING_NEED_WAKEUP))
+		return;
+
+	/* AF_XDP sockets in copy mode also fail with EBUSY
+	 * while the kernel is still sending.
+	 */
+	if (sendto(engine->sk, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0 &&
+		errno != EBUSY && !transient_send_error(errno))
+		warn("sendto() failed to kick AF_XDP socket");
+}
+
+/* Frames are posted in order, and a queue completes them in order,
+ * so only the number of completed frames matters.
+ */
+static inline void xdp_reap(struct sndpkt_xdp *xdp)
+{
+	uint32_t prod = __atomic_load_n(xdp->cq.producer, __ATOMIC_ACQUIRE);
+	if (prod == xdp->completed)
+		return;
+	xdp->completed = prod;
+	__atomic_store_n(xdp->cq.consumer, prod, __ATOMIC_RELEASE);
+}
+
+static int xdp_send_batch(struct sndpkt_engine *engine,
+	union net_addr **addrs, int n)
+{
+	struct sndpkt_xdp *xdp = &engine->xdp;
+	uint32_t mask = xdp->frame_nr - 1;
+	uint32_t available;
+	int i;
+
+	assert(n >= 1 && n <= SNDPKT_MAX_BATCH);
+	xdp_reap(xdp);
+	available = xdp->frame_nr - (xdp->posted - xdp->completed);
+	if (n > available)
+		n = available;
+
+	/* Descriptors are already in the TX ring, and the frames already
+	 * hold a copy of the template, so only write the destinations.
+	 */
+	for (i = 0; i < n; i++) {
+		uint32_t idx = (xdp->posted + i) & mask;
+		engine->set_dst(engine, xdp->umem + (size_t)idx *
+			xdp->frame_size + ETHER_HDR_LEN, addrs[i]);
+	}
+	xdp->posted += n;
+	__atomic_store_n(xdp->tx.producer, xdp->posted, __ATOMIC_RELEASE);
+
+	/* In copy mode, the kernel only transmits while kicked,
+	 * so kick it even when the ring is full.
+	 */
+	xdp_flush(engine);
+	return n;
+}
+
+static int xdp_send_packet(struct sndpkt_engine *engine,
+	union net_addr *addr)
+{
+	return xdp_send_batch(engine, &addr, 1);
+}
+
+static void map_xsk_ring(int sk, struct sndpkt_xsk_ring *ring,
+	const struct xdp_ring_offset *off, size_t desc_size, uint32_t size,
+	off_t pgoff)
+{
+	char *map;
+
+	ring->map_len = off->desc + desc_size * size;
+	map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, sk, pgoff);
+	if (map == MAP_FAILED)
+		err(1, "mmap() of AF_XDP ring failed");
+
+	ring->map = map;
+	ring->producer = (uint32_t *)(map + off->producer);
+	ring->consumer = (uint32_t *)(map + off->consumer);
+	ring->flags = (uint32_t *)(map + off->flags);
+	ring->descs = map + off->desc;
+}
+
+/* AF_XDP sends whole frames, so build the Ethernet header that
+ * the kernel adds for the other backends.
+ */
+static void make_eth_header(struct ether_header *eth,
+	const struct sockaddr_ll *dev)
+{
+	struct ifreq ifr;
+	int sk = socket(AF_INET, SOCK_DGRAM, 0);
+
+	if (sk < 0)
+		err(1, "socket() failed");
+	memset(&ifr, 0, sizeof(ifr));
+	if (!if_indextoname(dev->sll_ifindex, ifr.ifr_name))
+		err(1, "if_indextoname(%i) failed", dev->sll_ifindex);
+	if (ioctl(sk, SIOCGIFHWADDR, &ifr))
+		err(1, "Can't obtain Ethernet address of `%s'", ifr.ifr_name);
+	assert(!close(sk));
+
+	assert(dev->sll_halen == ETHER_ADDR_LEN);
+	memmove(eth->ether_dhost, dev->sll_addr, ETHER_ADDR_LEN);
+	memmove(eth->ether_shost, ifr.ifr_hwaddr.sa_data, ETHER_ADDR_LEN);
+	eth->ether_type = dev->sll_protocol;
+}
+
+static void init_xdp(struct sndpkt_engine *engine, int queue)
+{
+	struct sndpkt_xdp *xdp = &engine->xdp;
+	int frame_len = ETHER_HDR_LEN + engine->template_len;
+	struct ether_header eth;
+	struct xdp_umem_reg reg;
+	struct xdp_mmap_offsets off;
+	struct sockaddr_xdp sxdp;
+	socklen_t optlen;
+	struct xdp_desc *descs;
+	unsigned int size, i;
+
+	/* Chunks must be a power of 2 in [2048..PAGE_SIZE]. */
+	xdp->frame_size = 2048;
+	while (xdp->frame_size < frame_len)
+		xdp->frame_size <<= 1;
+	if (xdp->frame_size > sysconf(_SC_PAGESIZE))
+		errx(1, "Packets of %i bytes do not fit in AF_XDP frames",
+			frame_len);
+	xdp->frame_nr = XDP_FRAMES;
+	xdp->posted = 0;
+	xdp->completed = 0;
+
+	/* Fill the UMEM with copies of the template. */
+	xdp->umem_len = (size_t)xdp->frame_size * xdp->frame_nr;
+	xdp->umem = mmap(NULL, xdp->umem_len, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (xdp->umem == MAP_FAILED)
+		err(1, "mmap() of UMEM failed");
+	make_eth_header(&eth, &engine->dev);
+	for (i = 0; i < xdp->frame_nr; i++) {
+		char *frame = xdp->umem + (size_t)i * xdp->frame_size;
+		memmove(frame, &eth, ETHER_HDR_LEN);
+		memmove(frame + ETHER_HDR_LEN, engine->pkt_template,
+			engine->template_len);
+	}
+
+	engine->sk = socket(AF_XDP, SOCK_RAW, 0);
+	if (engine->sk < 0)
+		err(1, "socket(AF_XDP) failed");
+
+	memset(&reg, 0, sizeof(reg));
+	reg.addr = (uintptr_t)xdp->umem;
+	reg.len = xdp->umem_len;
+	reg.chunk_size = xdp->frame_size;
+	reg.headroom = 0;
+	if (setsockopt(engine->sk, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)))
+		err(1, "setsockopt(XDP_UMEM_REG) failed");
+
+	/* The kernel requires a fill ring even though nothing is received. */
+	size = xdp->frame_nr;
+	if (setsockopt(engine->sk, SOL_XDP, XDP_UMEM_FILL_RING,
+			&size, sizeof(size)) ||
+		setsockopt(engine->sk, SOL_XDP, XDP_UMEM_COMPLETION_RING,
+			&size, sizeof(size)) ||
+		setsockopt(engine->sk, SOL_XDP, XDP_TX_RING,
+			&size, sizeof(size)))
+		err(1, "Can't set sizes of AF_XDP rings");
+
+	optlen = sizeof(off);
+	if (getsockopt(engine->sk, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen))
+		err(1, "getsockopt(XDP_MMAP_OFFSETS) failed");
+	map_xsk_ring(engine->sk, &xdp->tx, &off.tx, sizeof(struct xdp_desc),
+		size, XDP_PGOFF_TX_RING);
+	map_xsk_ring(engine->sk, &xdp->cq, &off.cr, sizeof(uint64_t),
+		size, XDP_UMEM_PGOFF_COMPLETION_RING);
+
+	/* Frame i always goes in entry i of the TX ring. */
+	descs = xdp->tx.descs;
+	for (i = 0; i < xdp->frame_nr; i++) {
+		descs[i].addr = (uint64_t)i * xdp->frame_size;
+		descs[i].len = frame_len;
+		descs[i].options = 0;
+	}
+
+	/* Use zero-copy (native) mode when the driver supports it,
+	 * otherwise fall back to copy (generic) mode.
+	 */
+	memset(&sxdp, 0, sizeof(sxdp));
+	sxdp.sxdp_family = AF_XDP;
+	sxdp.sxdp_ifindex = engine->dev.sll_ifindex;
+	sxdp.sxdp_queue_id = queue;
+	sxdp.sxdp_flags = XDP_ZEROCOPY | XDP_USE_NEED_WAKEUP;
+	if (bind(engine->sk, (struct sockaddr *)&sxdp, sizeof(sxdp))) {
+		sxdp.sxdp_flags = XDP_COPY | XDP_USE_NEED_WAKEUP;
+		if (bind(engine->sk, (struct sockaddr *)&sxdp, sizeof(sxdp)))
+			err(1, "Can't bind AF_XDP socket to queue %i", queue);
+	}
+
+	engine->send_packet = xdp_send_packet;
+	engine->send_batch = xdp_send_batch;
+	engine->flush = xdp_flush;
+}
+
+static void end_xdp(struct sndpkt_engine *engine)
+{
+	struct sndpkt_xdp *xdp = &engine->xdp;
+	assert(!munmap(xdp->cq.map, xdp->cq.map_len));
+	assert(!munmap(xdp->tx.map, xdp->tx.map_len));
+	assert(!munmap(xdp->umem, xdp->umem_len));
+	xdp->umem = NULL;
+}
+
+static void ipv4_set_dst(struct sndpkt_engine *engine, char *pkt,
+	union net_addr *addr)
+{
+	set_ipv4_template(pkt, addr->ip, engine->cookie.ip.sum);
+}
+
+static void xia_set_dst(struct sndpkt_engine *engine, char *pkt,
+	union net_addr *addr)
+{
+	set_xia_template(pkt, engine->cookie.xia.offset, addr);
 }
 
 /* XXX Once XIA has gone mainline, this define should come from the kernel. */
 #define ETH_P_XIP	0xC0DE
 
-void init_sndpkt_engine(struct sndpkt_engine *engine, const char *stack,
-	const char *ifname, int packet_len,
+void init_sndpkt_engine(struct sndpkt_engine *engine, const char *backend,
+	const char *stack, const char *ifname, int queue, int packet_len,
 	const unsigned char *dst_mac, int mac_len,
 	const char *dst_addr_type)
 {
-	engine->sk = socket(AF_PACKET, SOCK_DGRAM, 0);
-	if (engine->sk < 0)
-		err(EXIT_FAILURE, "socket() failed");
-
 	packet_len -= ETHER_HDR_LEN; /* Kernel will add Ethernet header. */
 	engine->template_len = packet_len;
 	engine->pkt_template = malloc(packet_len);
@@ -297,23 +749,38 @@ void init_sndpkt_engine(struct sndpkt_engine *engine, const char *stack,
 		set_dev(&engine->dev, ifname, ETH_P_IP, dst_mac, mac_len);
 		make_ipv4_template(engine->pkt_template, packet_len,
 			src_ip, &engine->cookie.ip.sum);
-		engine->send_packet = ipv4_send_packet;
+		engine->set_dst = ipv4_set_dst;
 	} else if (!strcmp(stack, "xia")) {
 		set_dev(&engine->dev, ifname, ETH_P_XIP, dst_mac, mac_len);
 		make_xia_template(engine->pkt_template, packet_len,
 			dst_addr_type, &engine->cookie.xia.offset);
-		engine->send_packet = xia_send_packet;
+		engine->set_dst = xia_set_dst;
 	} else {
 		errx(1, "Stack `%s' is not valid", stack);
 	}
 
-	/* Put only @ifname in promiscuous mode. */
-	assert(!bind(engine->sk, (const struct sockaddr *)&engine->dev,
-		sizeof(engine->dev)));
+	engine->batch.pkts = NULL;
+	engine->ring.map = NULL;
+	engine->xdp.umem = NULL;
+	if (!strcmp(backend, "socket")) {
+		init_socket(engine);
+	} else if (!strcmp(backend, "ring")) {
+		init_ring(engine);
+	} else if (!strcmp(backend, "xdp")) {
+		init_xdp(engine, queue);
+	} else {
+		errx(1, "Backend `%s' is not valid", backend);
+	}
 }
 
 void end_sndpkt_engine(struct sndpkt_engine *engine)
 {
-	free(engine->pkt_template);
+	if (engine->batch.pkts)
+		end_socket(engine);
+	if (engine->ring.map)
+		end_ring(engine);
 	assert(!close(engine->sk));
+	if (engine->xdp.umem)
+		end_xdp(engine);
+	free(engine->pkt_template);
 }
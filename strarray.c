@@ -3,12 +3,16 @@
 #include <assert.h>
 #include <string.h>
 #include <err.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
 
+#include <utils.h>
 #include <strarray.h>
+#include <shmem.h>
 
 /* Replace '\0' in @buf to @ch, and return the numer of lines in @buf.
  *
@@ -131,79 +135,577 @@ void print_array(char **array, uint64_t size)
 		printf("%" PRIu64 ":%s\n", i, array[i]);
 }
 
-static void shuffle_array(char **array, uint64_t size,
-	uint32_t *seeds, int seeds_len)
+/* The shuffle is the serial Fisher-Yates shuffle of the original array
+ * of lines, so prefixes keep their order across versions, and
+ * across numbers of CPUs. It runs on all CPUs with deterministic
+ * reservations; see Shun et al., "Sequential random permutation, list
+ * contraction and tree contraction are highly parallel", SODA 2015.
+ *
+ * Swap i exchanges positions i and target(i) >= i. Swaps are taken in
+ * order into a window. Each swap of the window reserves both of its
+ * positions, and the earliest swap wins every position. Swaps that win
+ * both positions run at once, since no earlier swap is pending on
+ * them. The others stay in the window for the next round.
+ */
+#define SHUFFLE_WINDOW	(1L << 20)	/* Maximum swaps per round.	*/
+#define SHUFFLE_CHUNK	(1L << 14)	/* Swaps per parallel task.	*/
+#define SHUFFLE_SERIAL	(1L << 15)	/* Last positions done serially. */
+#define SHUFFLE_FREE	UINT32_MAX
+
+/* Swap records @i and @j of @data. */
+typedef void (*swap_records_t)(void *data, uint64_t i, uint64_t j);
+
+struct shuffle_job {
+	swap_records_t swap_records;
+	void *data;
+	uint32_t *owner;	/* Earliest swap of each position.	*/
+	uint32_t *swap;		/* Swaps of the window.			*/
+	uint32_t *target;
+	uint8_t *done;
+	long count;		/* Swaps in the window.			*/
+};
+
+static void swap_prefixes(void *data, uint64_t i, uint64_t j)
+{
+	struct net_prefix *prefix = data;
+	struct net_prefix tmp = prefix[i];
+	prefix[i] = prefix[j];
+	prefix[j] = tmp;
+}
+
+static inline void reserve_position(uint32_t *owner, uint32_t swap)
+{
+	uint32_t old = __atomic_load_n(owner, __ATOMIC_RELAXED);
+	while (swap < old && !__atomic_compare_exchange_n(owner, &old, swap,
+		1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+static inline long chunk_end(struct shuffle_job *job, long c)
+{
+	long end = (c + 1) * SHUFFLE_CHUNK;
+	return end < job->count ? end : job->count;
+}
+
+static void reserve_chunk(void *arg, long c)
+{
+	struct shuffle_job *job = arg;
+	long k, end = chunk_end(job, c);
+
+	for (k = c * SHUFFLE_CHUNK; k < end; k++) {
+		reserve_position(&job->owner[job->swap[k]], job->swap[k]);
+		reserve_position(&job->owner[job->target[k]], job->swap[k]);
+	}
+}
+
+static void commit_chunk(void *arg, long c)
+{
+	struct shuffle_job *job = arg;
+	long k, end = chunk_end(job, c);
+
+	for (k = c * SHUFFLE_CHUNK; k < end; k++) {
+		uint32_t i = job->swap[k], j = job->target[k];
+		job->done[k] = job->owner[i] == i && job->owner[j] == i;
+		if (job->done[k])
+			job->swap_records(job->data, i, j);
+	}
+}
+
+static void release_chunk(void *arg, long c)
+{
+	struct shuffle_job *job = arg;
+	long k, end = chunk_end(job, c);
+
+	for (k = c * SHUFFLE_CHUNK; k < end; k++) {
+		job->owner[job->swap[k]] = SHUFFLE_FREE;
+		job->owner[job->target[k]] = SHUFFLE_FREE;
+	}
+}
+
+static void shuffle_records(swap_records_t swap_records, void *data,
+	uint64_t size, uint32_t *seeds, int seeds_len)
 {
 	struct unif_state shuffle_dist;
+	struct shuffle_job job;
+	uint64_t i, next = 0;
+	long k, pending;
 
 	if (size <= 1)
 		return;
-
 	init_unif(&shuffle_dist, seeds, seeds_len);
-	do {
-		uint64_t b = sample_unif_0_n1(&shuffle_dist, size);
-		if (b) {
-			/* b is not index 0, so swap array[0] and array[b]. */
-			char *tmp = array[0];
-			array[0] = array[b];
-			array[b] = tmp;
+
+	/* Reservations only pay off with many CPUs and many swaps. */
+	if (count_cpus() > 1 &&
+		size > 2 * SHUFFLE_SERIAL) {
+		assert(size < SHUFFLE_FREE);
+		job.swap_records = swap_records;
+		job.data = data;
+		job.owner = malloc(sizeof(*job.owner) * size);
+		job.swap = malloc(sizeof(*job.swap) * SHUFFLE_WINDOW);
+		job.target = malloc(sizeof(*job.target) * SHUFFLE_WINDOW);
+		job.done = malloc(sizeof(*job.done) * SHUFFLE_WINDOW);
+		assert(job.owner && job.swap && job.target && job.done);
+		memset(job.owner, 0xff, sizeof(*job.owner) * size);
+
+		pending = 0;
+		while (size - next > SHUFFLE_SERIAL) {
+			/* Keep the window small relative to the positions
+			 * left, so most swaps win their positions.
+			 */
+			long window = (size - next) / 8;
+			if (window > SHUFFLE_WINDOW)
+				window = SHUFFLE_WINDOW;
+
+			/* Draw targets in the order of the serial shuffle. */
+			for (; pending < window; pending++, next++) {
+				job.swap[pending] = next;
+				job.target[pending] = next +
+					sample_unif_0_n1(&shuffle_dist,
+						size - next);
+			}
+
+			job.count = pending;
+			k = (pending + SHUFFLE_CHUNK - 1) / SHUFFLE_CHUNK;
+			run_chunks(reserve_chunk, &job, k);
+			run_chunks(commit_chunk, &job, k);
+			run_chunks(release_chunk, &job, k);
+
+			/* Keep the pending swaps in order. */
+			pending = 0;
+			for (k = 0; k < job.count; k++) {
+				if (job.done[k])
+					continue;
+				job.swap[pending] = job.swap[k];
+				job.target[pending] = job.target[k];
+				pending++;
+			}
 		}
-		array++;
-		size--;
-	} while (size > 1);
+
+		/* The pending swaps precede all others. */
+		for (k = 0; k < pending; k++)
+			swap_records(data, job.swap[k], job.target[k]);
+		free(job.done);
+		free(job.target);
+		free(job.swap);
+		free(job.owner);
+	}
+
+	for (i = next; i < size - 1; i++)
+		swap_records(data, i,
+			i + sample_unif_0_n1(&shuffle_dist, size - i));
 	end_unif(&shuffle_dist);
 }
 
+static void shuffle_prefixes(struct net_prefix *prefix, uint64_t size,
+	uint32_t *seeds, int seeds_len)
+{
+	shuffle_records(swap_prefixes, prefix, size, seeds, seeds_len);
+}
+
+/* Parse a decimal number of at most @digits digits at *@pp, and
+ * advance *@pp past it. Return -1 if there is no digit.
+ */
+static inline int parse_dec(const char **pp, const char *end, int digits)
+{
+	const char *p = *pp;
+	int val = 0;
+
+	while (p < end && digits-- > 0 && (unsigned char)(*p - '0') < 10)
+		val = val * 10 + (*p++ - '0');
+	if (p == *pp)
+		return -1;
+	*pp = p;
+	return val;
+}
+
+static inline int parse_sep(const char **pp, const char *end, char sep)
+{
+	if (*pp < end && **pp == sep) {
+		(*pp)++;
+		return 0;
+	}
+	return -1;
+}
+
+static void set_prefix(struct net_prefix *pp, int a, int b, int c, int d,
+	int m, int force_addr);
+
+/* Parse prefix "a.b.c.d/m" in [@p, @end) into @pp.
+ * Return 0 on success; anything after the mask is ignored, unless
+ * it is a digit, so the mask has no more than two digits.
+ */
+static int parse_prefix(const char *p, const char *end,
+	struct net_prefix *pp, int force_addr)
+{
+	int a, b, c, d, m;
+
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	a = parse_dec(&p, end, 3);
+	if (parse_sep(&p, end, '.'))
+		return -1;
+	b = parse_dec(&p, end, 3);
+	if (parse_sep(&p, end, '.'))
+		return -1;
+	c = parse_dec(&p, end, 3);
+	if (parse_sep(&p, end, '.'))
+		return -1;
+	d = parse_dec(&p, end, 3);
+	if (parse_sep(&p, end, '/'))
+		return -1;
+	m = parse_dec(&p, end, 2);
+	if (p < end && (unsigned char)(*p - '0') < 10)
+		return -1;
+
+	/* Missing numbers are -1, so a single test per number is enough. */
+	if ((unsigned)a > 255 || (unsigned)b > 255 || (unsigned)c > 255 ||
+		(unsigned)d > 255 || m < 8 || m > 32)
+		return -1;
+
+	set_prefix(pp, a, b, c, d, m, force_addr);
+	return 0;
+}
+
+/* Set @pp to prefix a.b.c.d/@m, or an address of it if @force_addr. */
+static void set_prefix(struct net_prefix *pp, int a, int b, int c, int d,
+	int m, int force_addr)
+{
+	pp->mask = m;
+	if (!force_addr)
+		m = 32;
+
+	/* In order to make it an address (it's originally a prefix),
+	 * and avoid multiple prefixes maching the address (IP uses
+	 * longest prefix matching), one has to set the bit just
+	 * after the mask.
+	 */
+	pp->addr.id[0] = a;
+	pp->addr.id[1] =  8 <= m && m < 16 ? b | (0x80 >> (m -  8)) : b;
+	pp->addr.id[2] = 16 <= m && m < 24 ? c | (0x80 >> (m - 16)) : c;
+	pp->addr.id[3] = 24 <= m && m < 32 ? d | (0x80 >> (m - 24)) : d;
+	memset(&pp->addr.id[4], 0, sizeof(pp->addr) - 4);
+	pp->port = 0;
+}
+
+/* Files are parsed in chunks of PARSE_CHUNK bytes on all CPUs.
+ * A chunk holds the lines that start within it, so
+ * every chunk finds its own lines.
+ */
+#define PARSE_CHUNK	(1L << 22)
+
+struct parse_job {
+	const char *content;
+	uint64_t size;
+	struct net_prefix *prefix;
+	uint64_t *first;	/* Index of the first line of each chunk. */
+	uint64_t *bad;		/* First bad line of each chunk + 1.	*/
+	int force_addr;
+};
+
+/* RETURN the start of the first line that starts at or after @pos. */
+static const char *line_start(struct parse_job *job, uint64_t pos)
+{
+	const char *end = job->content + job->size;
+	const char *p;
+
+	if (pos >= job->size)
+		return end;
+	if (!pos || job->content[pos - 1] == '\n')
+		return job->content + pos;
+	/* memchr() scans for newlines with SIMD instructions. */
+	p = memchr(job->content + pos, '\n', job->size - pos);
+	return p ? p + 1 : end;
+}
+
+static void count_chunk(void *arg, long c)
+{
+	struct parse_job *job = arg;
+	const char *p = line_start(job, c * PARSE_CHUNK);
+	const char *end = line_start(job, (c + 1) * PARSE_CHUNK);
+	uint64_t lines = 0;
+
+	while (p < end) {
+		const char *eol = memchr(p, '\n', end - p);
+		lines++;
+		if (!eol)
+			break;
+		p = eol + 1;
+	}
+	job->first[c + 1] = lines;
+}
+
+static void parse_chunk(void *arg, long c)
+{
+	struct parse_job *job = arg;
+	const char *p = line_start(job, c * PARSE_CHUNK);
+	const char *end = line_start(job, (c + 1) * PARSE_CHUNK);
+	uint64_t line = job->first[c];
+
+	job->bad[c] = 0;
+	while (p < end) {
+		const char *eol = memchr(p, '\n', end - p);
+		if (!eol)
+			eol = end;
+		if (parse_prefix(p, eol, &job->prefix[line], job->force_addr)
+			&& !job->bad[c])
+			job->bad[c] = line + 1;
+		line++;
+		p = eol + 1;
+	}
+}
+
+/* The file is mapped, and parsed straight into the array of prefixes,
+ * which is the only copy of the data.
+ */
+struct net_prefix *load_file_as_addrs(const char *filename,
+	uint64_t *parray_size, int force_addr)
+{
+	struct parse_job job;
+	struct stat st;
+	long c, chunks;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		err(1, "Can't open file `%s'", filename);
+	if (fstat(fd, &st))
+		err(1, "Can't find size of file `%s'", filename);
+	*parray_size = 0;
+	if (!st.st_size) {
+		assert(!close(fd));
+		return NULL;
+	}
+	job.content = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (job.content == MAP_FAILED)
+		err(1, "Can't map file `%s'", filename);
+	assert(!close(fd));
+	job.size = st.st_size;
+	job.force_addr = force_addr;
+
+	/* Count the lines of each chunk to place their prefixes. */
+	chunks = (job.size + PARSE_CHUNK - 1) / PARSE_CHUNK;
+	job.first = malloc(sizeof(*job.first) * (chunks + 1));
+	job.bad = malloc(sizeof(*job.bad) * chunks);
+	assert(job.first && job.bad);
+	job.first[0] = 0;
+	run_chunks(count_chunk, &job, chunks);
+	for (c = 0; c < chunks; c++)
+		job.first[c + 1] += job.first[c];
+
+	job.prefix = malloc(sizeof(*job.prefix) * job.first[chunks]);
+	assert(job.prefix);
+	run_chunks(parse_chunk, &job, chunks);
+	for (c = 0; c < chunks; c++)
+		if (job.bad[c])
+			errx(1, "Line %" PRIu64 " of file `%s' is not "
+				"a prefix like `a.b.c.d/m'",
+				job.bad[c], filename);
+
+	assert(!munmap((void *)job.content, job.size));
+	*parray_size = job.first[chunks];
+	free(job.bad);
+	free(job.first);
+	return job.prefix;
+}
+
 struct net_prefix *load_file_as_shuffled_addrs(const char *filename,
 	uint64_t *parray_size, uint32_t *seeds, int seeds_len, int force_addr)
 {
-	char **prefix_array =
-		load_file_as_array(filename, parray_size);
-	struct net_prefix *prefix, *pp;
-	uint64_t i, bytes;
+	struct net_prefix *prefix = load_file_as_addrs(filename, parray_size,
+		force_addr);
+	shuffle_prefixes(prefix, *parray_size, seeds, seeds_len);
+	return prefix;
+}
 
-	if (!(*parray_size))
-		return NULL;
-	shuffle_array(prefix_array, *parray_size, seeds, seeds_len);
-	/*
-	print_array(prefix_array, *parray_size);
-	*/
+/* Synthetic IPv4 prefixes are placed in a bitmap of the /24 blocks
+ * of the unicast space below 224.0.0.0, so they never overlap.
+ * Only prefixes of length 8 to 24 are generated, as most routers
+ * drop longer ones from BGP.
+ */
+#define SYNTH_BLOCKS	(224L << 16)
+#define SYNTH_TRIES	8	/* Random placements per prefix length. */
 
-	bytes = sizeof(*prefix) * (*parray_size);
-	prefix = malloc(bytes);
-	assert(prefix);
+/* Relative frequencies of prefix lengths 8 to 24 in the IPv4 BGP table. */
+static const uint32_t bgp_mask_weight[] = {
+	16, 13, 37, 107, 294, 584, 1205, 2096, 13600,
+	8300, 14100, 26000, 43000, 55000, 130000, 110000, 560000,
+};
 
-	/* Convert prefixes into binary addresses. */
-	pp = prefix;
-	for (i = 0; i < *parray_size; i++) {
-		int a, b, c, d, m;
-		assert(sscanf(prefix_array[i], "%i.%i.%i.%i/%i",
-			&a, &b, &c, &d, &m) == 5);
-		assert(0 <= a && a <= 255);
-		assert(0 <= b && b <= 255);
-		assert(0 <= c && c <= 255);
-		assert(0 <= d && d <= 255);
-		assert(8 <= m && m <= 32);
-
-		pp->mask = m;
-		if (!force_addr)
-			m = 32;
-
-		/* In order to make it an address (it's originally a prefix),
-		 * and avoid multiple prefixes maching the address (IP uses
-		 * longest prefix matching), one has to set the bit just
-		 * after the mask.
-		 */
-		pp->addr.id[0] = a;
-		pp->addr.id[1] =  8 <= m && m < 16 ? b | (0x80 >> (m -  8)) : b;
-		pp->addr.id[2] = 16 <= m && m < 24 ? c | (0x80 >> (m - 16)) : c;
-		pp->addr.id[3] = 24 <= m && m < 32 ? d | (0x80 >> (m - 24)) : d;
-		memset(&pp->addr.id[4], 0, sizeof(pp->addr) - 4);
+/* Blocks that are not routed on the Internet. */
+static const struct {
+	uint8_t a, b, m;
+} reserved_blocks[] = {
+	{0, 0, 8}, {10, 0, 8}, {100, 64, 10}, {127, 0, 8}, {169, 254, 16},
+	{172, 16, 12}, {192, 168, 16}, {198, 18, 15},
+};
+
+static inline int blocks_free(const uint64_t *map, long block, long len)
+{
+	long i;
+
+	if (len < 64)
+		return !(map[block / 64] >> (block % 64) &
+			(((uint64_t)1 << len) - 1));
+	for (i = block / 64; i < (block + len) / 64; i++)
+		if (map[i])
+			return 0;
+	return 1;
+}
+
+static inline void take_blocks(uint64_t *map, long block, long len)
+{
+	long i;
 
-		pp++;
+	if (len < 64) {
+		map[block / 64] |= (((uint64_t)1 << len) - 1) << (block % 64);
+		return;
+	}
+	for (i = block / 64; i < (block + len) / 64; i++)
+		map[i] = UINT64_MAX;
+}
+
+/* RETURN the first free block at or after @block, wrapping around. */
+static long next_free_block(const uint64_t *map, long block)
+{
+	long i = block / 64;
+	uint64_t word = map[i] | ((((uint64_t)1 << (block % 64)) - 1));
+
+	while (word == UINT64_MAX) {
+		i = (i + 1) % (SYNTH_BLOCKS / 64);
+		word = map[i];
+	}
+	return i * 64 + __builtin_ctzll(~word);
+}
+
+/* Place a prefix of length @m in @map, or a longer one if it does
+ * not fit. RETURN its first block, and update *@pm.
+ */
+static long place_prefix(uint64_t *map, int *pm, struct unif_state *unif)
+{
+	long block, len;
+	int m, t;
+
+	for (m = *pm; m <= 24; m++) {
+		len = 1L << (24 - m);
+		for (t = 0; t < SYNTH_TRIES; t++) {
+			block = sample_unif_0_n1(unif, SYNTH_BLOCKS) &
+				~(len - 1);
+			if (blocks_free(map, block, len))
+				goto found;
+		}
+	}
+	/* Nearly full; any free block goes. */
+	m = 24;
+	len = 1;
+	block = next_free_block(map, block);
+
+found:
+	take_blocks(map, block, len);
+	*pm = m;
+	return block;
+}
+
+static void generate_ip_prefixes(struct net_prefix *prefix, uint64_t n,
+	struct unif_state *unif, int force_addr)
+{
+	const int nweights = sizeof(bgp_mask_weight) /
+		sizeof(bgp_mask_weight[0]);
+	uint64_t i, free_blocks = SYNTH_BLOCKS, total = 0, demand = 0;
+	uint64_t count[25];
+	int k, m, min_mask = 8;
+	uint64_t *map;
+	uint8_t *mask;
+
+	map = calloc(SYNTH_BLOCKS / 64, sizeof(*map));
+	assert(map);
+	for (k = 0; k < sizeof(reserved_blocks) / sizeof(reserved_blocks[0]);
+		k++) {
+		long len = 1L << (24 - reserved_blocks[k].m);
+		long block = reserved_blocks[k].a << 16 |
+			reserved_blocks[k].b << 8;
+		assert(blocks_free(map, block, len));
+		take_blocks(map, block, len);
+		free_blocks -= len;
 	}
+	if (n > free_blocks)
+		errx(1, "There are at most %" PRIu64 " synthetic prefixes",
+			free_blocks);
 
-	free_array(prefix_array);
+	/* Draw the lengths first, so that prefixes can be placed from
+	 * the shortest to the longest, and short prefixes find room.
+	 */
+	for (k = 0; k < nweights; k++)
+		total += bgp_mask_weight[k];
+	memset(count, 0, sizeof(count));
+	mask = malloc(n ? n : 1);
+	assert(mask);
+	for (i = 0; i < n; i++) {
+		long r = sample_unif_0_n1(unif, total);
+		for (m = 8; r >= bgp_mask_weight[m - 8]; m++)
+			r -= bgp_mask_weight[m - 8];
+		mask[i] = m;
+		count[m]++;
+		demand += 1L << (24 - m);
+	}
+
+	/* Large tables do not fit with the lengths of the BGP table,
+	 * which has overlapping prefixes; lengthen the shortest prefixes
+	 * until they fill at most 3/4 of the space, so that random
+	 * placements still succeed.
+	 */
+	for (m = 8; demand > free_blocks / 4 * 3 && m < 24; m++) {
+		demand -= count[m] << (23 - m);
+		count[m + 1] += count[m];
+		min_mask = m + 1;
+	}
+
+	for (m = min_mask; m <= 24; m++)
+		for (i = 0; i < n; i++) {
+			int pm = m;
+			long block;
+
+			if ((mask[i] < min_mask ? min_mask : mask[i]) != m)
+				continue;
+			block = place_prefix(map, &pm, unif);
+			set_prefix(&prefix[i], block >> 16,
+				(block >> 8) & 0xff, block & 0xff, 0, pm,
+				force_addr);
+		}
+	free(mask);
+	free(map);
+}
+
+struct net_prefix *generate_prefixes(uint64_t n, int stack,
+	uint32_t *seeds, int seeds_len, int force_addr)
+{
+	struct net_prefix *prefix;
+	struct unif_state unif;
+	uint64_t i;
+	int k;
+
+	prefix = malloc(sizeof(*prefix) * (n ? n : 1));
+	assert(prefix);
+	init_unif(&unif, seeds, seeds_len);
+	switch (stack) {
+	case PREFIX_TABLE_IP:
+		generate_ip_prefixes(prefix, n, &unif, force_addr);
+		break;
+
+	case PREFIX_TABLE_XIA:
+		/* IDs are so long that they never collide in practice. */
+		for (i = 0; i < n; i++) {
+			for (k = 0; k < sizeof(prefix[i].addr.id); k++)
+				prefix[i].addr.id[k] =
+					sample_unif_0_n1(&unif, 256);
+			prefix[i].mask = 8 * sizeof(prefix[i].addr.id);
+			prefix[i].port = 0;
+		}
+		break;
+
+	default:
+		assert(0);
+	}
+	end_unif(&unif);
 	return prefix;
 }
 
@@ -212,10 +714,574 @@ void free_net_prefix(struct net_prefix *prefix)
 	free(prefix);
 }
 
-void assign_port(struct net_prefix *prefix, uint64_t array_size, int ports,
-	struct unif_state *unif)
+/* Resize @table to @array_size prefixes. */
+static void resize_prefix_table(struct prefix_table *table,
+	uint64_t array_size)
+{
+	assert(!table->map_len);
+	table->n = array_size;
+	if (!array_size)
+		array_size = 1;	/* Keep pointers valid. */
+
+	switch (table->stack) {
+	case PREFIX_TABLE_IP:
+		table->ip = realloc(table->ip, sizeof(*table->ip) * array_size);
+		assert(table->ip);
+		break;
+
+	case PREFIX_TABLE_XIA:
+		table->xid = realloc(table->xid,
+			sizeof(*table->xid) * array_size);
+		table->meta = realloc(table->meta,
+			sizeof(*table->meta) * array_size);
+		assert(table->xid && table->meta);
+		break;
+
+	default:
+		assert(0);
+	}
+}
+
+static inline void set_prefix_table_entry(struct prefix_table *table,
+	uint64_t i, const struct net_prefix *prefix)
+{
+	if (table->stack == PREFIX_TABLE_IP) {
+		table->ip[i].ip = prefix->addr.ip;
+		table->ip[i].port = prefix->port;
+		table->ip[i].mask = prefix->mask;
+	} else {
+		table->xid[i] = prefix->addr;
+		table->meta[i].port = prefix->port;
+		table->meta[i].mask = prefix->mask;
+	}
+}
+
+static void swap_prefix_table_entries(void *data, uint64_t i, uint64_t j)
+{
+	struct prefix_table *table = data;
+
+	if (table->stack == PREFIX_TABLE_IP) {
+		struct ip_prefix tmp = table->ip[i];
+		table->ip[i] = table->ip[j];
+		table->ip[j] = tmp;
+	} else {
+		union net_addr xid = table->xid[i];
+		struct prefix_meta meta = table->meta[i];
+		table->xid[i] = table->xid[j];
+		table->meta[i] = table->meta[j];
+		table->xid[j] = xid;
+		table->meta[j] = meta;
+	}
+}
+
+static void start_prefix_table(struct prefix_table *table, int stack,
+	uint64_t array_size)
+{
+	table->stack = stack;
+	table->ip = NULL;
+	table->xid = NULL;
+	table->meta = NULL;
+	table->map_len = 0;
+	table->meta_map_len = 0;
+	resize_prefix_table(table, array_size);
+}
+
+void init_prefix_table(struct prefix_table *table, int stack,
+	const struct net_prefix *prefix, uint64_t array_size)
 {
 	uint64_t i;
+
+	start_prefix_table(table, stack, array_size);
 	for (i = 0; i < array_size; i++)
-		prefix[i].port = sample_unif_0_n1(unif, ports);
+		set_prefix_table_entry(table, i, &prefix[i]);
+}
+
+void end_prefix_table(struct prefix_table *table)
+{
+	if (table->map_len) {
+		detach_shmem(table->stack == PREFIX_TABLE_IP ?
+			(void *)table->ip : (void *)table->xid,
+			table->map_len);
+		if (table->meta_map_len)
+			detach_shmem(table->meta, table->meta_map_len);
+	} else {
+		free(table->meta);
+		free(table->xid);
+		free(table->ip);
+	}
+	table->meta = NULL;
+	table->xid = NULL;
+	table->ip = NULL;
+	table->map_len = 0;
+	table->meta_map_len = 0;
+}
+
+/* Point @table at the mapped arrays of @array_size prefixes of @stack.
+ * For XIA, @meta may be NULL when the masks and ports follow the IDs.
+ */
+static void map_prefix_table(struct prefix_table *table, int stack,
+	char *data, char *meta, uint64_t array_size)
+{
+	table->stack = stack;
+	table->n = array_size;
+	table->ip = NULL;
+	table->xid = NULL;
+	table->meta = NULL;
+	if (stack == PREFIX_TABLE_IP) {
+		table->ip = (struct ip_prefix *)data;
+		return;
+	}
+	table->xid = (union net_addr *)data;
+	table->meta = (struct prefix_meta *)(meta ? meta :
+		data + array_size * sizeof(*table->xid));
+}
+
+/* RETURN the number of bytes that the arrays of @stack take per prefix. */
+static uint32_t prefix_record_bytes(int stack)
+{
+	return stack == PREFIX_TABLE_IP ? sizeof(struct ip_prefix) :
+		sizeof(union net_addr) + sizeof(struct prefix_meta);
+}
+
+static const char *stack_name(int stack)
+{
+	return stack == PREFIX_TABLE_IP ? "IP" : "XIA";
+}
+
+/* Layout of binary prefix files of write_prefix_file(). */
+#define PREFIX_FILE_MAGIC	"NETEVPFX"
+#define PREFIX_FILE_VERSION	2
+#define PREFIX_FILE_MAX_SEEDS	32
+
+struct prefix_file_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t stack;		/* PREFIX_TABLE_*. */
+	uint32_t record_bytes;	/* prefix_record_bytes() of the writer. */
+	uint32_t force_addr;
+	int32_t seeds_len;	/* Zero if the records are not shuffled. */
+	uint32_t unused;
+	uint64_t count;
+	uint32_t seeds[PREFIX_FILE_MAX_SEEDS];
+};
+
+/* The arrays of the table start at this offset, so they are page aligned
+ * once mapped; for XIA, the masks and ports follow the IDs.
+ * It is the offset of shared-memory objects as well, so
+ * detach_shmem() unmaps both alike.
+ */
+#define PREFIX_FILE_DATA_OFFSET	SHMEM_DATA_OFFSET
+
+void write_prefix_file(const char *filename, const struct prefix_table *table,
+	uint32_t *seeds, int seeds_len, int force_addr)
+{
+	char tmp[PATH_MAX], pad[PREFIX_FILE_DATA_OFFSET];
+	struct prefix_file_hdr hdr;
+	uint64_t n = table->n;
+	FILE *f;
+	int ok;
+
+	assert(seeds_len >= 0 && seeds_len <= PREFIX_FILE_MAX_SEEDS);
+	memset(&hdr, 0, sizeof(hdr));
+	memmove(hdr.magic, PREFIX_FILE_MAGIC, sizeof(hdr.magic));
+	hdr.version = PREFIX_FILE_VERSION;
+	hdr.stack = table->stack;
+	hdr.record_bytes = prefix_record_bytes(table->stack);
+	hdr.force_addr = force_addr;
+	hdr.seeds_len = seeds_len;
+	hdr.count = n;
+	memmove(hdr.seeds, seeds, seeds_len * sizeof(*seeds));
+
+	/* Write to a temporary file, and rename it, so other processes
+	 * never map a partial file.
+	 */
+	if (snprintf(tmp, sizeof(tmp), "%s.%i", filename, getpid()) >=
+		sizeof(tmp))
+		errx(1, "Name `%s' is too long", filename);
+	f = fopen(tmp, "w");
+	if (!f)
+		err(1, "Can't create file `%s'", tmp);
+	memset(pad, 0, sizeof(pad));
+	ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+		fwrite(pad, sizeof(pad) - sizeof(hdr), 1, f) == 1;
+	if (table->stack == PREFIX_TABLE_IP)
+		ok = ok && fwrite(table->ip, sizeof(*table->ip), n, f) == n;
+	else
+		ok = ok && fwrite(table->xid, sizeof(*table->xid), n, f) == n &&
+			fwrite(table->meta, sizeof(*table->meta), n, f) == n;
+	if (!ok)
+		err(1, "Can't write file `%s'", tmp);
+	if (fclose(f))
+		err(1, "Can't write file `%s'", tmp);
+	if (rename(tmp, filename))
+		err(1, "Can't rename file `%s' to `%s'", tmp, filename);
+}
+
+/* RETURN true if @filename is a binary prefix file. */
+static int is_prefix_file(const char *filename)
+{
+	char magic[sizeof(((struct prefix_file_hdr *)0)->magic)];
+	int fd, ret;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		err(1, "Can't open file `%s'", filename);
+	ret = read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+		!memcmp(magic, PREFIX_FILE_MAGIC, sizeof(magic));
+	assert(!close(fd));
+	return ret;
+}
+
+/* Map the binary prefix file @filename into @table;
+ * see load_prefix_table().
+ */
+static uint64_t map_prefix_file(struct prefix_table *table, int stack,
+	const char *filename, uint64_t limit, uint32_t *seeds, int seeds_len,
+	int force_addr)
+{
+	struct prefix_file_hdr hdr;
+	size_t map_len;
+	char *map;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		err(1, "Can't open file `%s'", filename);
+	if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+		errx(1, "Binary prefix file `%s' is truncated", filename);
+	if (hdr.version != PREFIX_FILE_VERSION ||
+		(hdr.stack != PREFIX_TABLE_IP &&
+		hdr.stack != PREFIX_TABLE_XIA) ||
+		hdr.record_bytes != prefix_record_bytes(hdr.stack))
+		errx(1, "Binary prefix file `%s' has an unsupported format; "
+			"convert its prefix file again", filename);
+	if (hdr.stack != stack)
+		errx(1, "Binary prefix file `%s' holds prefixes of the %s "
+			"stack, but the %s stack needs them", filename,
+			stack_name(hdr.stack), stack_name(stack));
+	if (hdr.force_addr != !!force_addr)
+		errx(1, "Binary prefix file `%s' holds %s, but %s are needed",
+			filename, hdr.force_addr ? "addresses" : "prefixes",
+			force_addr ? "addresses" : "prefixes");
+	if (hdr.seeds_len && (hdr.seeds_len != seeds_len ||
+		memcmp(hdr.seeds, seeds, seeds_len * sizeof(*seeds))))
+		errx(1, "Binary prefix file `%s' was shuffled for another run",
+			filename);
+	map_len = PREFIX_FILE_DATA_OFFSET + hdr.count * hdr.record_bytes;
+	if (lseek(fd, 0, SEEK_END) != map_len)
+		errx(1, "Binary prefix file `%s' is truncated", filename);
+
+	/* Pages are shared with the page cache, and other processes,
+	 * unless the shuffle below or the caller writes them.
+	 */
+	map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		err(1, "Can't map file `%s'", filename);
+	assert(!close(fd));
+
+	map_prefix_table(table, stack, map + PREFIX_FILE_DATA_OFFSET, NULL,
+		hdr.count);
+	table->map_len = map_len;
+	table->meta_map_len = 0;
+	if (!hdr.seeds_len)
+		shuffle_records(swap_prefix_table_entries, table, hdr.count,
+			seeds, seeds_len);
+	if (limit && limit < hdr.count)
+		table->n = limit;
+	return hdr.count;
+}
+
+static int make_prefix_table_key(uint64_t *key, int stack,
+	const char *filename, uint32_t *seeds, int seeds_len, int force_addr)
+{
+	struct stat st;
+	int len = 0;
+
+	if (stat(filename, &st))
+		err(1, "Can't stat file `%s'", filename);
+	assert((seeds_len + 1) / 2 + 5 <= SHMEM_KEY_LEN);
+	key[len++] = st.st_size;
+	key[len++] = st.st_mtim.tv_sec;
+	key[len++] = st.st_mtim.tv_nsec;
+	key[len++] = force_addr;
+	key[len++] = stack;
+	return len + seeds_to_shmem_key(key + len, seeds, seeds_len);
+}
+
+void publish_prefix_table(const char *name, const char *meta_name,
+	const char *filename, const struct prefix_table *table,
+	uint32_t *seeds, int seeds_len, int force_addr)
+{
+	uint64_t key[SHMEM_KEY_LEN];
+	int len = make_prefix_table_key(key, table->stack, filename,
+		seeds, seeds_len, force_addr);
+
+	if (table->stack == PREFIX_TABLE_IP) {
+		publish_shmem(name, key, len, table->ip, sizeof(*table->ip),
+			table->n);
+		/* Do not leave the masks and ports of older XIA tables. */
+		unlink_shmem(meta_name);
+		return;
+	}
+	publish_shmem(name, key, len, table->xid, sizeof(*table->xid),
+		table->n);
+	publish_shmem(meta_name, key, len, table->meta, sizeof(*table->meta),
+		table->n);
+}
+
+uint64_t attach_prefix_table(struct prefix_table *table, int stack,
+	const char *name, const char *meta_name, const char *filename,
+	uint64_t limit, uint32_t *seeds, int seeds_len, int force_addr)
+{
+	uint64_t key[SHMEM_KEY_LEN], count, meta_count;
+	size_t map_len, meta_map_len = 0;
+	const void *data, *meta = NULL;
+	int len = make_prefix_table_key(key, stack, filename,
+		seeds, seeds_len, force_addr);
+
+	data = attach_shmem(name, key, len, stack == PREFIX_TABLE_IP ?
+		sizeof(struct ip_prefix) : sizeof(union net_addr),
+		&count, &map_len);
+	if (stack == PREFIX_TABLE_XIA) {
+		meta = attach_shmem(meta_name, key, len,
+			sizeof(struct prefix_meta), &meta_count,
+			&meta_map_len);
+		if (meta_count != count)
+			errx(1, "Shared memory objects `%s' and `%s' "
+				"do not match", name, meta_name);
+	}
+
+	/* The arrays are read-only, so writing them faults. */
+	map_prefix_table(table, stack, (char *)data, (char *)meta, count);
+	table->map_len = map_len;
+	table->meta_map_len = meta_map_len;
+	if (limit && limit < count)
+		table->n = limit;
+	return count;
+}
+
+/* Text prefix files are streamed in chunks of STREAM_CHUNK bytes,
+ * so they never need to fit in memory.
+ */
+#define STREAM_CHUNK	(1L << 22)
+
+/* Call @fn(@arg, line, eol, index) for every line of @filename, where
+ * [line, eol) is the line without its newline.
+ * RETURN the number of lines.
+ */
+static uint64_t stream_lines(const char *filename,
+	void (*fn)(void *arg, const char *line, const char *eol,
+		uint64_t index), void *arg)
+{
+	uint64_t index = 0;
+	size_t len = 0;		/* Bytes in @buf. */
+	char *buf;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		err(1, "Can't open file `%s'", filename);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	buf = malloc(STREAM_CHUNK);
+	assert(buf);
+
+	while (1) {
+		ssize_t n = read(fd, buf + len, STREAM_CHUNK - len);
+		const char *p = buf, *end, *eol;
+
+		if (n < 0)
+			err(1, "Can't read file `%s'", filename);
+		len += n;
+		end = buf + len;
+		/* memchr() scans for newlines with SIMD instructions. */
+		while ((eol = memchr(p, '\n', end - p))) {
+			fn(arg, p, eol, index++);
+			p = eol + 1;
+		}
+		if (!n) {
+			/* The last line may not end with a newline. */
+			if (p < end)
+				fn(arg, p, end, index++);
+			break;
+		}
+
+		/* Carry the partial line over to the next chunk. */
+		len = end - p;
+		if (len == STREAM_CHUNK)
+			errx(1, "Line %" PRIu64 " of file `%s' is too long",
+				index + 1, filename);
+		memmove(buf, p, len);
+	}
+
+	free(buf);
+	assert(!close(fd));
+	return index;
+}
+
+static void count_line(void *arg, const char *line, const char *eol,
+	uint64_t index)
+{
+}
+
+struct stream_job {
+	struct prefix_table *table;
+	const char *filename;
+	int force_addr;
+
+	/* Selected lines as (index << 32) | slot in increasing order,
+	 * or NULL to take every line.
+	 */
+	uint64_t *selected;
+	uint64_t count;
+	uint64_t next;
+};
+
+static void load_line(void *arg, const char *line, const char *eol,
+	uint64_t index)
+{
+	struct stream_job *job = arg;
+	struct net_prefix prefix;
+	uint64_t slot;
+
+	if (job->selected) {
+		if (job->next >= job->count ||
+			job->selected[job->next] >> 32 != index)
+			return;
+		slot = (uint32_t)job->selected[job->next++];
+	} else {
+		slot = index;
+		if (slot >= job->table->n)
+			resize_prefix_table(job->table, 2 * job->table->n);
+	}
+
+	if (parse_prefix(line, eol, &prefix, job->force_addr))
+		errx(1, "Line %" PRIu64 " of file `%s' is not "
+			"a prefix like `a.b.c.d/m'", index + 1, job->filename);
+	set_prefix_table_entry(job->table, slot, &prefix);
+}
+
+/* Hash map from positions to lines for select_lines(). */
+struct line_map {
+	uint64_t *pos;		/* Position + 1; zero is a free slot. */
+	uint32_t *line;
+	uint64_t mask;
+};
+
+static uint32_t *line_map_find(struct line_map *map, uint64_t pos)
+{
+	uint64_t slot = (pos * 0x9e3779b97f4a7c15ULL) >> 24 & map->mask;
+
+	while (map->pos[slot] && map->pos[slot] != pos + 1)
+		slot = (slot + 1) & map->mask;
+	if (!map->pos[slot]) {
+		map->pos[slot] = pos + 1;
+		map->line[slot] = pos;	/* Positions start at their line. */
+	}
+	return &map->line[slot];
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+/* RETURN the lines that the first @limit positions of the shuffle of
+ * @size lines hold, as (index << 32) | position in increasing order.
+ *
+ * Swap i of the shuffle only touches positions >= i, so the first
+ * @limit swaps settle the first @limit positions; they are replayed
+ * with only the positions they touch.
+ */
+static uint64_t *select_lines(uint64_t size, uint64_t limit,
+	uint32_t *seeds, int seeds_len)
+{
+	struct unif_state shuffle_dist;
+	struct line_map map;
+	uint64_t i, slots = 1, *selected;
+	uint32_t *head;
+
+	assert(limit <= size && size <= UINT32_MAX);
+	head = malloc(sizeof(*head) * limit);
+	assert(head);
+	for (i = 0; i < limit; i++)
+		head[i] = i;
+	/* Each swap displaces at most one position past @limit. */
+	while (slots < 2 * limit)
+		slots <<= 1;
+	map.pos = calloc(slots, sizeof(*map.pos));
+	map.line = malloc(sizeof(*map.line) * slots);
+	assert(map.pos && map.line);
+	map.mask = slots - 1;
+
+	init_unif(&shuffle_dist, seeds, seeds_len);
+	for (i = 0; i < limit && i < size - 1; i++) {
+		uint64_t j = i + sample_unif_0_n1(&shuffle_dist, size - i);
+		uint32_t *pj = j < limit ? &head[j] : line_map_find(&map, j);
+		uint32_t tmp = head[i];
+		head[i] = *pj;
+		*pj = tmp;
+	}
+	end_unif(&shuffle_dist);
+	free(map.line);
+	free(map.pos);
+
+	selected = malloc(sizeof(*selected) * limit);
+	assert(selected);
+	for (i = 0; i < limit; i++)
+		selected[i] = (uint64_t)head[i] << 32 | i;
+	free(head);
+	qsort(selected, limit, sizeof(*selected), cmp_u64);
+	return selected;
+}
+
+uint64_t load_prefix_table(struct prefix_table *table, int stack,
+	const char *filename, uint64_t limit, uint32_t *seeds, int seeds_len,
+	int force_addr)
+{
+	struct stream_job job;
+	uint64_t size;
+
+	if (is_prefix_file(filename))
+		return map_prefix_file(table, stack, filename, limit,
+			seeds, seeds_len, force_addr);
+
+	job.filename = filename;
+	job.force_addr = force_addr;
+	job.table = table;
+	job.next = 0;
+	if (limit) {
+		/* Only load the lines that the shuffle puts first,
+		 * unless they are most lines anyway.
+		 */
+		size = stream_lines(filename, count_line, NULL);
+		if (limit < size / 2) {
+			start_prefix_table(table, stack, limit);
+			job.selected = select_lines(size, limit, seeds,
+				seeds_len);
+			job.count = limit;
+			stream_lines(filename, load_line, &job);
+			free(job.selected);
+			return size;
+		}
+	}
+
+	/* Load every line, and shuffle them in place. */
+	start_prefix_table(table, stack, 1024);
+	job.selected = NULL;
+	size = stream_lines(filename, load_line, &job);
+	resize_prefix_table(table, size);
+	shuffle_records(swap_prefix_table_entries, table, size,
+		seeds, seeds_len);
+	if (limit && limit < size)
+		resize_prefix_table(table, limit);
+	return size;
+}
+
+void assign_port(struct prefix_table *table, int ports,
+	struct unif_state *unif)
+{
+	uint64_t i;
+	for (i = 0; i < table->n; i++)
+		set_prefix_table_port(table, i, sample_unif_0_n1(unif, ports));
 }
@@ -1,6 +1,11 @@
+#define _GNU_SOURCE		/* sched_getaffinity()	*/
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
+#include <err.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include <utils.h>
 
@@ -15,6 +20,18 @@ long arg_to_long(const struct argp_state *state, const char *arg)
 	return l;
 }
 
+double arg_to_double(const struct argp_state *state, const char *arg)
+{
+	char *end;
+	double d;
+	if (!arg)
+		argp_error(state, "A float must be provided");
+	d = strtod(arg, &end);
+	if (!*arg || *end)
+		argp_error(state, "'%s' is not a float", arg);
+	return d;
+}
+
 double now(void)
 {
 	struct timespec tp;
@@ -39,3 +56,61 @@ void nsleep(double seconds)
 		assert(errno == EINTR);
 	}
 }
+
+struct chunk_worker {
+	pthread_t thread;
+	void (*fn)(void *arg, long chunk);
+	void *arg;
+	long first;
+	long step;
+	long chunks;
+};
+
+static void *run_chunk_worker(void *arg)
+{
+	struct chunk_worker *w = arg;
+	long c;
+	for (c = w->first; c < w->chunks; c += w->step)
+		w->fn(w->arg, c);
+	return NULL;
+}
+
+long count_cpus(void)
+{
+	cpu_set_t allowed;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed))
+		return sysconf(_SC_NPROCESSORS_ONLN);
+	return CPU_COUNT(&allowed);
+}
+
+void run_chunks(void (*fn)(void *arg, long chunk), void *arg,
+	long chunks)
+{
+	long cpus = count_cpus();
+	struct chunk_worker *workers;
+	int i, n;
+
+	n = cpus < chunks ? cpus : chunks;
+	if (n < 1)
+		n = 1;
+	workers = malloc(sizeof(*workers) * n);
+	assert(workers);
+
+	for (i = 0; i < n; i++) {
+		struct chunk_worker *w = &workers[i];
+		w->fn = fn;
+		w->arg = arg;
+		w->first = i;
+		w->step = n;
+		w->chunks = chunks;
+		/* The caller is worker 0. */
+		if (i > 0 && pthread_create(&w->thread, NULL,
+			run_chunk_worker, w))
+			errx(1, "Can't create thread %i of chunks", i);
+	}
+	run_chunk_worker(&workers[0]);
+	for (i = 1; i < n; i++)
+		assert(!pthread_join(workers[i].thread, NULL));
+	free(workers);
+}
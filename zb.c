@@ -0,0 +1,172 @@
+/* Zipf Benchmark. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <err.h>
+#include <argp.h>
+
+#include <utils.h>
+#include <rdist.h>
+
+/* Argp's global variables. */
+const char *argp_program_version = "Zipf benchmark 1.0";
+
+static char doc[] = "ZB -- measure how many Zipf samples per second "
+	"the inverse-CDF sampler draws for growing numbers of ranks";
+
+static struct argp_option options[] = {
+	{"s",		'z', "S",	0,
+		"Exponent characterizing the distribution"},
+	{"from",	'f', "N",	0, "Smallest number of ranks"},
+	{"to",		't', "N",	0,
+		"Largest number of ranks; it grows 10x per round"},
+	{"samples",	'n', "N",	0, "Number of samples per round"},
+	{ 0 }
+};
+
+struct args {
+	double s;
+	long from;
+	long to;
+	long samples;
+};
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+	struct args *args = state->input;
+
+	switch (key) {
+	case 'z':
+		args->s = arg_to_double(state, arg);
+		if (args->s < 0.0)
+			argp_error(state, "S must be >= 0");
+		break;
+
+	case 'f':
+		args->from = arg_to_long(state, arg);
+		if (args->from < 1)
+			argp_error(state, "Number of ranks must be >= 1");
+		break;
+
+	case 't':
+		args->to = arg_to_long(state, arg);
+		if (args->to < 1)
+			argp_error(state, "Number of ranks must be >= 1");
+		break;
+
+	case 'n':
+		args->samples = arg_to_long(state, arg);
+		if (args->samples < 1)
+			argp_error(state, "Number of samples must be >= 1");
+		break;
+
+	case ARGP_KEY_INIT:
+		args->s = 1.0;
+		args->from = 1000;
+		args->to = 100000000;
+		args->samples = 10000000;
+		break;
+
+	case ARGP_KEY_ARG:
+		argp_error(state, "There is no argument");
+		break;
+
+	case ARGP_KEY_END:
+		if (args->from > args->to)
+			argp_error(state, "FROM must be <= TO");
+		break;
+
+	default:
+		return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+
+static struct argp argp = {options, parse_opt, NULL, doc};
+
+/* Plain binary search over the whole CDF, i.e. sample_zipf() without
+ * its guide table.
+ */
+static long bsearch_zipf(struct zipf_state *state, double z)
+{
+	long a = 0;
+	long b = state->n - 1;
+
+	while (b - a >= 2) {
+		long c = (a + b) / 2;
+		if (state->cdf[c] <= z)
+			a = c;
+		else
+			b = c;
+	}
+	if (a < b && state->cdf[b] <= z)
+		a = b;
+	return a + 1;
+}
+
+static double *draw_unif(long samples)
+{
+	uint32_t seeds[] = {1, 2, 3, 4};
+	struct unif_state unif;
+	double *z = malloc(sizeof(*z) * samples);
+	long i;
+
+	assert(z);
+	init_unif(&unif, seeds, sizeof(seeds) / sizeof(seeds[0]));
+	for (i = 0; i < samples; i++)
+		z[i] = dsfmt_genrand_close_open(&unif.state);
+	end_unif(&unif);
+	return z;
+}
+
+int main(int argc, char **argv)
+{
+	struct args args;
+	double *z;
+	long *a, *b;
+	long n;
+
+	/* Read parameters. */
+	argp_parse(&argp, argc, argv, 0, NULL, &args);
+
+	z = draw_unif(args.samples);
+	a = malloc(sizeof(*a) * args.samples);
+	b = malloc(sizeof(*b) * args.samples);
+	assert(a && b);
+
+	printf("%12s %16s %16s\n", "n", "guide (samp/s)", "bsearch (samp/s)");
+	for (n = args.from; n <= args.to; n *= 10) {
+		struct zipf_state zipf;
+		double t0, t1, t2;
+		long i;
+
+		init_zipf(&zipf, args.s, n);
+
+		t0 = now();
+		for (i = 0; i < args.samples; i++)
+			a[i] = sample_zipf(&zipf, z[i]);
+		t1 = now();
+		for (i = 0; i < args.samples; i++)
+			b[i] = bsearch_zipf(&zipf, z[i]);
+		t2 = now();
+
+		for (i = 0; i < args.samples; i++)
+			if (a[i] != b[i])
+				errx(1, "Samplers disagree at n=%li, z=%.17g: "
+					"%li != %li", n, z[i], a[i], b[i]);
+
+		printf("%12li %16.0f %16.0f\n", n, args.samples / (t1 - t0),
+			args.samples / (t2 - t1));
+		fflush(stdout);
+		end_zipf(&zipf);
+
+		if (n > args.to / 10)
+			break;
+	}
+
+	free(b);
+	free(a);
+	free(z);
+	return 0;
+}